@@ -37,11 +37,25 @@ main (int argc, char *argv[])
       return EXIT_FAILURE;
     }
 
-  /* Copy data. */
+  /* Reserve the space in one piece, the copy may still succeed
+     without it. */
+  fallocate (out_fd, 0, filesize (in_fd));
+
+  /* Copy data.  Holes already read as zeros in the new file, so
+     only the ranges between them are copied. */
   for (;;) 
     {
       char buffer[1024];
-      int bytes_read = read (in_fd, buffer, sizeof buffer);
+      int data = seek_data (in_fd, tell (in_fd), SEEK_DATA);
+      int hole, bytes_read;
+      if (data < 0)
+        break;
+      hole = seek_data (in_fd, data, SEEK_HOLE);
+      seek (in_fd, data);
+      seek (out_fd, data);
+      bytes_read = read (in_fd, buffer,
+                         hole - data < (int) sizeof buffer
+                         ? hole - data : (int) sizeof buffer);
       if (bytes_read == 0)
         break;
       if (write (out_fd, buffer, bytes_read) != bytes_read) 
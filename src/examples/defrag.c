@@ -0,0 +1,48 @@
+/* defrag.c
+
+   Moves the data of each file named on the command line into as
+   few runs of consecutive sectors as possible, and reports the
+   number of such runs, and of runs of free sectors on the disk,
+   before and after. */
+
+#include <stdio.h>
+#include <syscall.h>
+
+int
+main (int argc, char *argv[]) 
+{
+  bool success = true;
+  int i;
+
+  if (argc < 2)
+    {
+      printf ("usage: defrag FILE...\n");
+      return EXIT_FAILURE;
+    }
+
+  for (i = 1; i < argc; i++)
+    {
+      struct defrag_stats stats;
+      int fd = open (argv[i]);
+
+      if (fd < 0)
+        {
+          printf ("%s: open failed\n", argv[i]);
+          success = false;
+          continue;
+        }
+      if (!defrag (fd, &stats))
+        {
+          printf ("%s: defrag failed\n", argv[i]);
+          success = false;
+        }
+      else
+        printf ("%s: %u sectors in %u extents, now %u; "
+                "free space in %u extents, now %u\n",
+                argv[i], stats.sectors, stats.extents_before,
+                stats.extents_after, stats.free_extents_before,
+                stats.free_extents_after);
+      close (fd);
+    }
+  return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -43,6 +43,10 @@ main (int argc, char *argv[])
       return EXIT_FAILURE;
     }
 
+  /* Reserve the space in one piece, the copy may still succeed
+     without it. */
+  fallocate (out_fd, 0, size);
+
   /* Map files. */
   in_map = mmap (in_fd, in_data);
   if (in_map == MAP_FAILED) 
@@ -4,6 +4,7 @@
 #include <string.h>
 #include <round.h>
 #include "filesys/filesys.h"
+#include "filesys/journal.h"
 #include "threads/synch.h"
 #include "threads/thread.h"
 #include "threads/malloc.h"
@@ -17,6 +18,10 @@ const bool print_cache_state = false;
 
 // static functions
 static cache_t get_and_lock_sector_data(block_sector_t sector);
+static void overwrite_block(block_sector_t sector, size_t ofs,
+                            void *data, size_t length, bool meta);
+static void overwrite_new(block_sector_t sector, size_t ofs,
+                          void *data, size_t length, bool meta);
 static void set_accessed (cache_t idx,
                           bool    accessed);
 static void set_dirty (cache_t idx,
@@ -25,6 +30,9 @@ static void set_pin (cache_t idx,
                      bool    pin);
 static void set_unready (cache_t idx,
                          bool    unready);
+static void set_journal (cache_t idx,
+                         bool    journal);
+static void throttle (void);
 static void pin (cache_t idx);
 static void *idx_to_ptr(cache_t idx);
 
@@ -41,7 +49,8 @@ enum cache_state {
     ACCESSED = 1<<0,
     DIRTY = 1<<1,
     PIN = 1<<2, // bitte bitte lieber evict algorithm, lass meinen Block im Cache
-    UNREADY = 1<<3 // Eintrag wird mal Daten für sector enthalten, aber nocht nicht jetzt, warte auf condition und recheck
+    UNREADY = 1<<3, // Eintrag wird mal Daten für sector enthalten, aber nocht nicht jetzt, warte auf condition und recheck
+    JOURNAL = 1<<4 // changed metadata, not written in place before the next journal commit
 };
 typedef uint8_t cache_state_t;
 
@@ -49,6 +58,7 @@ struct cache_entry {
     volatile block_sector_t sector;
     uint16_t refs;
     cache_state_t state;
+    tid_t writer; // thread that dirtied the entry last
     struct lock lock;
     struct condition cond;
 };
@@ -63,6 +73,19 @@ void *blocks[CACHE_SIZE];
 struct cache_entry *blocks_meta;
 // next block to check for eviction
 volatile cache_t evict_ptr;
+// number of entries with JOURNAL set
+static size_t journal_cnt;
+// number of entries with DIRTY set
+static size_t dirty_cnt;
+
+// Dirty data throttling. Once more than DIRTY_HIGH entries are dirty, or
+// more than DIRTY_LOW and the writer itself dirtied more than
+// DIRTY_PER_WRITER of them, the writer writes back its own entries, so
+// that threads missing the cache rarely have to write back for it. The
+// two limits apply independently.
+#define DIRTY_HIGH (CACHE_SIZE / 2)
+#define DIRTY_LOW (CACHE_SIZE / 4)
+#define DIRTY_PER_WRITER (CACHE_SIZE / 8)
 
 /***********************************************************
  * Configuration / Data for cache END
@@ -178,10 +201,14 @@ void sched_background(void *aux UNUSED) {
             } else {
                 log_debug(":S: BLCK_WRTR is writing... :S:\n");
                 lock_acquire_re(&block_meta_lock);
-                block_write(fs_device,
-                            r->sector,
-                            idx_to_ptr(r->idx));
-                set_dirty(r->idx, false);
+                // changed again since the write was scheduled, now
+                // it has to wait for the journal commit
+                if ((blocks_meta[r->idx].state & JOURNAL) == 0) {
+                    block_write(fs_device,
+                                r->sector,
+                                idx_to_ptr(r->idx));
+                    set_dirty(r->idx, false);
+                }
                 // mark cache as reusable again
                 unpin(r->idx);
                 lock_release_re(&block_meta_lock);
@@ -283,8 +310,90 @@ cache_t sched_insert(block_sector_t sector,
  * scheduler END
  ***********************************************************/
 
+/***********************************************************
+ * prefetch
+ ***********************************************************/
+// Sectors that will probably be read soon, e.g. the inodes of
+// directory entries just listed. A background thread reads them into
+// the cache, lowest sector first. The queue is only a hint: requests
+// that do not fit are dropped.
+#define PREFETCH_MAX 64
+
+static block_sector_t prefetch_queue[PREFETCH_MAX];
+static size_t prefetch_cnt;
+static struct lock prefetch_lock;
+static struct condition prefetch_cond;
+
+static
+void prefetch_background(void *aux UNUSED);
+
+static
+void prefetch_init(void) {
+    lock_init(&prefetch_lock);
+    cond_init(&prefetch_cond);
+    prefetch_cnt = 0;
+    thread_create("FS_PREFETCH", PRI_DEFAULT, prefetch_background, NULL);
+}
+
+/*
+ * Queues the `cnt` sectors in `sectors` to be read into the cache in
+ * the background. Returns without waiting for any of them.
+ */
+void cache_prefetch(const block_sector_t *sectors, size_t cnt) {
+    size_t i;
+
+    lock_acquire_re(&prefetch_lock);
+    for (i = 0; i < cnt && prefetch_cnt < PREFETCH_MAX; i++) {
+        block_sector_t sector = sectors[i];
+        size_t pos = prefetch_cnt;
+
+        if (sector >= block_size(fs_device)) {
+            continue;
+        }
+        // keep the queue sorted, without duplicates
+        while (pos > 0 && prefetch_queue[pos - 1] > sector) {
+            pos--;
+        }
+        if (pos > 0 && prefetch_queue[pos - 1] == sector) {
+            continue;
+        }
+        memmove(prefetch_queue + pos + 1, prefetch_queue + pos,
+                (prefetch_cnt - pos) * sizeof *prefetch_queue);
+        prefetch_queue[pos] = sector;
+        prefetch_cnt++;
+    }
+    cond_signal(&prefetch_cond, &prefetch_lock);
+    lock_release_re(&prefetch_lock);
+}
+
+static
+void prefetch_background(void *aux UNUSED) {
+    lock_acquire_re(&prefetch_lock);
+    while (true) {
+        block_sector_t sector;
+        uint8_t byte;
+
+        while (prefetch_cnt == 0) {
+            cond_wait(&prefetch_cond, &prefetch_lock);
+        }
+        sector = prefetch_queue[0];
+        prefetch_cnt--;
+        memmove(prefetch_queue, prefetch_queue + 1,
+                prefetch_cnt * sizeof *prefetch_queue);
+
+        lock_release_re(&prefetch_lock);
+        // a hit costs nothing, a miss loads the whole sector
+        in_cache_and_read(sector, 0, &byte, sizeof byte);
+        lock_acquire_re(&prefetch_lock);
+    }
+}
+/***********************************************************
+ * prefetch END
+ ***********************************************************/
+
 void cache_init() {
     sched_init();
+    prefetch_init();
     lock_init(&cache_lock);
 
     // init state
@@ -316,6 +425,7 @@ void cache_init() {
         blocks_meta[i].sector = NO_SECTOR;
         blocks_meta[i].state = 0;
         blocks_meta[i].refs = 0;
+        blocks_meta[i].writer = TID_ERROR;
 
         cond_init(&blocks_meta[i].cond);
     }
@@ -340,7 +450,12 @@ cache_t get_and_pin_block (block_sector_t sector) {
         ptr = evict_ptr;
         cnt++;
         if (ptr == 0) {
-            if (cnt == CACHE_SIZE) {
+            if (cnt == CACHE_SIZE && journal_cnt >= CACHE_SIZE / 2) {
+                // the cache fills up with metadata waiting for a journal
+                // commit, commit it now even if that splits operations
+                // still in progress, instead of waiting for them
+                cache_commit();
+            } else if (cnt == CACHE_SIZE) {
                 // be nice to the others
                 // apparently there is nothing to do for you right now
                 thread_yield();
@@ -358,6 +473,9 @@ cache_t get_and_pin_block (block_sector_t sector) {
                 }
                 // pinned page, may not do anything about it
                 goto cont1;
+            } else if ((blocks_meta[ptr].state & JOURNAL) != 0) {
+                // must not be written before its journal commit
+                goto cont1;
             } else if ((blocks_meta[ptr].state & DIRTY) == DIRTY) {
                 if (print_cache_state) {
                     log_debug("=|= %d is scheduled for write =|=\n", ptr);
@@ -410,16 +528,85 @@ done:
 
 /* Set a whole block to only zeros */
 void zero_out_sector_data(block_sector_t sector) {
+    in_cache_and_overwrite_new(sector, 0, NULL, 0);
+}
+
+/* Like `zero_out_sector_data` but for metadata */
+void zero_out_sector_meta(block_sector_t sector) {
+    in_cache_and_overwrite_new_meta(sector, 0, NULL, 0);
+}
+
+/*
+ * Like `in_cache_and_overwrite_block` but for freshly allocated sectors.
+ * The old content of `sector` is meaningless, so it is never read from
+ * disk. All bytes outside of `ofs` to `ofs + length` are set to zero.
+ *
+ * A sector may still be cached from a file it belonged to before it was
+ * freed. In that case the existing entry is reused, otherwise there would
+ * be two cache entries for the same sector.
+ */
+void in_cache_and_overwrite_new(block_sector_t  sector,
+                                size_t          ofs,
+                                void           *data,
+                                size_t          length) {
+    overwrite_new(sector, ofs, data, length, false);
+}
+
+/*
+ * Like `in_cache_and_overwrite_new` but for metadata, which is written
+ * through the journal.
+ */
+void in_cache_and_overwrite_new_meta(block_sector_t  sector,
+                                     size_t          ofs,
+                                     void           *data,
+                                     size_t          length) {
+    overwrite_new(sector, ofs, data, length, true);
+}
+
+static
+void overwrite_new(block_sector_t  sector,
+                   size_t          ofs,
+                   void           *data,
+                   size_t          length,
+                   bool            meta) {
+    ASSERT(ofs + length <= BLOCK_SECTOR_SIZE);
+    ASSERT(sector < block_size(fs_device));
+
     lock_acquire_re(&block_meta_lock);
     lock_acquire(&cache_lock);
-    cache_t idx = get_and_pin_block(sector);
-    lock_release(&cache_lock);
+    cache_t idx = NOT_IN_CACHE;
+    cache_t i;
+    for (i = 0; i < CACHE_SIZE; i++) {
+        if (blocks_meta[i].sector == sector) {
+            idx = i;
+            break;
+        }
+    }
+    if (idx == NOT_IN_CACHE) {
+        idx = get_and_pin_block(sector);
+        unpin(idx);
+        set_unready(idx, false);
+        lock_release(&cache_lock);
+    } else {
+        lock_release(&cache_lock);
+        // waits for pending reads of the old content
+        idx = get_and_lock_sector_data(sector);
+    }
 
-    lock_acquire_re(&block_meta_lock);
-    memset(idx_to_ptr(idx), 0, BLOCK_SECTOR_SIZE);
-    unpin(idx);
-    set_unready(idx, false);
-    lock_release_re(&block_meta_lock);
+    uint8_t *block = idx_to_ptr(idx);
+    memset(block, 0, ofs);
+    if (length > 0) {
+        memcpy(block + ofs, data, length);
+    }
+    memset(block + ofs + length, 0, BLOCK_SECTOR_SIZE - ofs - length);
+    set_dirty(idx, true);
+    if (meta) {
+        set_journal(idx, true);
+    }
+    set_accessed(idx, true);
+    if (!meta) {
+        throttle();
+    }
     lock_release_re(&block_meta_lock);
 }
 
@@ -500,6 +687,26 @@ void in_cache_and_overwrite_block(block_sector_t  sector,
                               size_t          ofs,
                               void           *data,
                               size_t          length) {
+    overwrite_block(sector, ofs, data, length, false);
+}
+
+/*
+ * Like `in_cache_and_overwrite_block` but for metadata, which is written
+ * through the journal.
+ */
+void in_cache_and_overwrite_meta(block_sector_t  sector,
+                                 size_t          ofs,
+                                 void           *data,
+                                 size_t          length) {
+    overwrite_block(sector, ofs, data, length, true);
+}
+
+static
+void overwrite_block(block_sector_t  sector,
+                     size_t          ofs,
+                     void           *data,
+                     size_t          length,
+                     bool            meta) {
     lock_acquire_re(&block_meta_lock);
     if (!(ofs + length <= BLOCK_SECTOR_SIZE)) {
         printf("ofs %d, length %d, BLOCK_SECTOR_SIZE %d\n", ofs, length, BLOCK_SECTOR_SIZE);
@@ -528,7 +735,13 @@ void in_cache_and_overwrite_block(block_sector_t  sector,
     // to, from, length
     memcpy(idx_to_ptr(ind)+ofs, data, length);
     set_dirty(ind, true);
+    if (meta) {
+        set_journal(ind, true);
+    }
     set_accessed(ind, true);
+    if (!meta) {
+        throttle();
+    }
     lock_release_re(&block_meta_lock);
     if (print_hex) {
         hex_dump(ofs, idx_to_ptr(ind), length, false);
@@ -537,6 +750,60 @@ void in_cache_and_overwrite_block(block_sector_t  sector,
     lock_release_re(&block_meta_lock);
 }
 
+/*
+ * Returns the cache entry holding `sector`, NOT_IN_CACHE if none.
+ * block_meta_lock must be held.
+ */
+static
+cache_t cache_find(block_sector_t sector) {
+    cache_t i;
+    for (i = 0; i < CACHE_SIZE; i++) {
+        if (blocks_meta[i].sector == sector) {
+            return i;
+        }
+    }
+    return NOT_IN_CACHE;
+}
+
+/*
+ * Reads the whole `sector` into `data` without bringing it into the cache.
+ * A cached copy, which may be newer than the disk, is used if there is one.
+ */
+void cache_read_direct(block_sector_t sector, void *data) {
+    ASSERT(sector < block_size(fs_device));
+    lock_acquire_re(&block_meta_lock);
+    cache_t idx = cache_find(sector);
+    if (idx != NOT_IN_CACHE) {
+        memcpy(data, idx_to_ptr(idx), BLOCK_SECTOR_SIZE);
+    } else {
+        block_read(fs_device, sector, data);
+    }
+    lock_release_re(&block_meta_lock);
+}
+
+/*
+ * Writes the whole `sector` from `data` to disk without bringing it into
+ * the cache. A cached copy is updated, so the cache stays coherent.
+ */
+void cache_write_direct(block_sector_t sector, const void *data) {
+    ASSERT(sector < block_size(fs_device));
+    lock_acquire_re(&block_meta_lock);
+    cache_t idx = cache_find(sector);
+    if (idx != NOT_IN_CACHE) {
+        memcpy(idx_to_ptr(idx), data, BLOCK_SECTOR_SIZE);
+    }
+    if (idx != NOT_IN_CACHE && (blocks_meta[idx].state & JOURNAL) != 0) {
+        // still metadata of the running journal commit, it writes it
+        set_dirty(idx, true);
+    } else {
+        block_write(fs_device, sector, data);
+        if (idx != NOT_IN_CACHE) {
+            set_dirty(idx, false);
+        }
+    }
+    lock_release_re(&block_meta_lock);
+}
+
 /* analoge in_cache_and_overwrite_block but read */;
 void in_cache_and_read(block_sector_t  sector,
                        size_t          ofs,
@@ -598,8 +865,15 @@ void set_dirty (cache_t idx, bool dirty) {
     ASSERT(idx < CACHE_SIZE);
     lock_acquire_re(&block_meta_lock);
     if (dirty) {
+        if ((blocks_meta[idx].state & DIRTY) == 0) {
+            dirty_cnt++;
+        }
         blocks_meta[idx].state |= DIRTY;
+        blocks_meta[idx].writer = thread_current()->tid;
     } else {
+        if ((blocks_meta[idx].state & DIRTY) != 0) {
+            dirty_cnt--;
+        }
         blocks_meta[idx].state &= ~DIRTY;
     }
     lock_release_re(&block_meta_lock);
@@ -621,6 +895,142 @@ void set_unready (cache_t idx, bool unready) {
     lock_release_re(&block_meta_lock);
 }
 
+/*
+ * Set the journal flag, keeps count of the entries waiting for a commit
+ */
+static
+void set_journal (cache_t idx, bool journal) {
+    // valid range
+    ASSERT(idx < CACHE_SIZE);
+    lock_acquire_re(&block_meta_lock);
+    if (journal && (blocks_meta[idx].state & JOURNAL) == 0) {
+        blocks_meta[idx].state |= JOURNAL;
+        journal_cnt++;
+    } else if (!journal && (blocks_meta[idx].state & JOURNAL) != 0) {
+        blocks_meta[idx].state &= ~JOURNAL;
+        journal_cnt--;
+    }
+    lock_release_re(&block_meta_lock);
+}
+
+/*
+ * Writes back entries dirtied by the current thread while the cache is
+ * over the dirty limits: above DIRTY_HIGH down to DIRTY_LOW, whatever the
+ * writer's share, and above DIRTY_LOW while the writer holds more than
+ * DIRTY_PER_WRITER entries, down to half of that. Entries waiting for the
+ * journal or in use are skipped.
+ * The victims are pinned and marked clean before block_meta_lock is
+ * released for the writes, so eviction leaves them alone and a change
+ * made meanwhile dirties them again.
+ */
+static
+void throttle (void) {
+    cache_t idx[CACHE_SIZE];
+    tid_t tid = thread_current()->tid;
+    size_t mine = 0, global = 0, own = 0, want, cnt = 0, i;
+    cache_t c;
+    int locks;
+
+    lock_acquire_re(&block_meta_lock);
+    if (dirty_cnt <= DIRTY_LOW) {
+        goto done;
+    }
+    for (c = 0; c < CACHE_SIZE; c++) {
+        if ((blocks_meta[c].state & DIRTY) != 0
+                && blocks_meta[c].writer == tid) {
+            mine++;
+        }
+    }
+    if (dirty_cnt > DIRTY_HIGH) {
+        global = dirty_cnt - DIRTY_LOW;
+    }
+    if (mine > DIRTY_PER_WRITER) {
+        own = mine - DIRTY_PER_WRITER / 2;
+    }
+    want = global > own ? global : own;
+    if (want > dirty_cnt - DIRTY_LOW) {
+        want = dirty_cnt - DIRTY_LOW;
+    }
+
+    for (c = 0; c < CACHE_SIZE && cnt < want; c++) {
+        struct cache_entry *e = &blocks_meta[c];
+        if ((e->state & DIRTY) == 0 || e->writer != tid
+                || (e->state & (JOURNAL | PIN | UNREADY)) != 0
+                || e->refs > 0) {
+            continue;
+        }
+        pin(c);
+        set_dirty(c, false);
+        idx[cnt++] = c;
+    }
+    if (cnt == 0) {
+        goto done;
+    }
+
+    locks = lock_release_re_mult(&block_meta_lock);
+    for (i = 0; i < cnt; i++) {
+        block_write(fs_device, blocks_meta[idx[i]].sector,
+                    idx_to_ptr(idx[i]));
+    }
+    lock_acquire_re_mult(&block_meta_lock, locks);
+    for (i = 0; i < cnt; i++) {
+        unpin(idx[i]);
+    }
+done:
+    lock_release_re(&block_meta_lock);
+}
+
+/*
+ * Returns the number of cached metadata sectors waiting for a journal
+ * commit.
+ */
+size_t cache_journal_cnt(void) {
+    return journal_cnt;
+}
+
+/*
+ * Writes all metadata changed since the last commit to the journal as one
+ * transaction and then in place, lowest sector first. Holds
+ * block_meta_lock throughout, so the commit sees no half written sector.
+ */
+void cache_commit(void) {
+    // static, the kernel stack is small, protected by block_meta_lock
+    static block_sector_t sectors[CACHE_SIZE];
+    static void *data[CACHE_SIZE];
+    static cache_t idx[CACHE_SIZE];
+    size_t cnt = 0, i;
+    cache_t c;
+
+    lock_acquire_re(&block_meta_lock);
+    for (c = 0; c < CACHE_SIZE; c++) {
+        if ((blocks_meta[c].state & JOURNAL) == 0) {
+            continue;
+        }
+        // keep sorted by sector for the in-place writes
+        for (i = cnt; i > 0 && sectors[i - 1] > blocks_meta[c].sector; i--) {
+            sectors[i] = sectors[i - 1];
+            data[i] = data[i - 1];
+            idx[i] = idx[i - 1];
+        }
+        sectors[i] = blocks_meta[c].sector;
+        data[i] = idx_to_ptr(c);
+        idx[i] = c;
+        cnt++;
+    }
+    ASSERT(cnt <= JOURNAL_BLOCKS);
+
+    if (cnt > 0) {
+        journal_write(sectors, data, cnt);
+        for (i = 0; i < cnt; i++) {
+            block_write(fs_device, sectors[i], data[i]);
+            set_dirty(idx[i], false);
+            set_journal(idx[i], false);
+        }
+        journal_clear();
+    }
+    lock_release_re(&block_meta_lock);
+}
+
 /*
  * Set the pin flag
  */
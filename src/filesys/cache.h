@@ -16,9 +16,27 @@ void in_cache_and_overwrite_block(block_sector_t  sector,
                                   size_t          ofs,
                                   void           *data,
                                   size_t          length);
+void in_cache_and_overwrite_new(block_sector_t  sector,
+                                size_t          ofs,
+                                void           *data,
+                                size_t          length);
+void zero_out_sector_meta(block_sector_t sector);
+void in_cache_and_overwrite_meta(block_sector_t  sector,
+                                 size_t          ofs,
+                                 void           *data,
+                                 size_t          length);
+void in_cache_and_overwrite_new_meta(block_sector_t  sector,
+                                     size_t          ofs,
+                                     void           *data,
+                                     size_t          length);
 void in_cache_and_read(block_sector_t  sector,
                        size_t          ofs,
                        void           *data,
                        size_t          length);
 void unpin (cache_t centry);
+void cache_read_direct(block_sector_t sector, void *data);
+void cache_write_direct(block_sector_t sector, const void *data);
+void cache_prefetch(const block_sector_t *sectors, size_t cnt);
+size_t cache_journal_cnt(void);
+void cache_commit(void);
 #endif
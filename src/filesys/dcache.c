@@ -0,0 +1,181 @@
+#include "filesys/dcache.h"
+#include <debug.h>
+#include <hash.h>
+#include <list.h>
+#include <string.h>
+#include "filesys/directory.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+
+/* Cache of directory entries, keyed by the inode sector of the
+   directory and the name.  Also remembers names which do not exist
+   in a directory (negative entries, sector 0), so failing lookups
+   skip the directory as well.
+
+   The directory code keeps it coherent: dir_add() and dir_remove()
+   drop the entry for the name they change while holding the lock of
+   the directory, and removing a directory drops everything cached
+   below it, as its sector may be reused. */
+
+/* Maximal number of cached entries. */
+#define DCACHE_SIZE 256
+
+/* Sector of a negative entry.  Sector 0 holds the free map inode,
+   which is in no directory. */
+#define DCACHE_NEGATIVE 0
+
+struct dentry
+  {
+    struct hash_elem elem;              /* In dcache. */
+    struct list_elem lru_elem;          /* In dcache_lru. */
+    block_sector_t dir;                 /* Sector of the directory. */
+    char name[NAME_MAX + 1];            /* Name in the directory. */
+    block_sector_t sector;              /* Inode sector of the entry. */
+    bool is_dir;                        /* Entry is a directory? */
+  };
+
+static struct hash dcache;
+static struct list dcache_lru;          /* Least recently used first. */
+static struct lock dcache_lock;
+
+static unsigned
+dentry_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  const struct dentry *d = hash_entry (e, struct dentry, elem);
+  return hash_string (d->name) ^ hash_int (d->dir);
+}
+
+static bool
+dentry_less (const struct hash_elem *a_, const struct hash_elem *b_,
+             void *aux UNUSED)
+{
+  const struct dentry *a = hash_entry (a_, struct dentry, elem);
+  const struct dentry *b = hash_entry (b_, struct dentry, elem);
+  if (a->dir != b->dir)
+    return a->dir < b->dir;
+  return strcmp (a->name, b->name) < 0;
+}
+
+/* Initializes the directory entry cache. */
+void
+dcache_init (void)
+{
+  hash_init (&dcache, dentry_hash, dentry_less, NULL);
+  list_init (&dcache_lru);
+  lock_init (&dcache_lock);
+}
+
+/* Returns the cached entry for NAME in directory DIR, or a null
+   pointer.  dcache_lock must be held. */
+static struct dentry *
+dentry_find (block_sector_t dir, const char *name)
+{
+  struct dentry key;
+  struct hash_elem *e;
+
+  if (strlen (name) > NAME_MAX)
+    return NULL;
+  key.dir = dir;
+  strlcpy (key.name, name, sizeof key.name);
+  e = hash_find (&dcache, &key.elem);
+  return e != NULL ? hash_entry (e, struct dentry, elem) : NULL;
+}
+
+/* Removes D from the cache and frees it.  dcache_lock must be
+   held. */
+static void
+dentry_free (struct dentry *d)
+{
+  hash_delete (&dcache, &d->elem);
+  list_remove (&d->lru_elem);
+  free (d);
+}
+
+/* Looks up NAME in directory DIR.
+   Returns false if nothing is cached.  Otherwise returns true and
+   stores the inode sector of the entry into *SECTORP and whether it
+   is a directory into *IS_DIRP, or 0 into *SECTORP if the directory
+   has no such entry. */
+bool
+dcache_lookup (block_sector_t dir, const char *name,
+               block_sector_t *sectorp, bool *is_dirp)
+{
+  struct dentry *d;
+
+  lock_acquire_re (&dcache_lock);
+  d = dentry_find (dir, name);
+  if (d != NULL)
+    {
+      *sectorp = d->sector;
+      *is_dirp = d->is_dir;
+      list_remove (&d->lru_elem);
+      list_push_back (&dcache_lru, &d->lru_elem);
+    }
+  lock_release_re (&dcache_lock);
+  return d != NULL;
+}
+
+/* Remembers that NAME in directory DIR is the inode in SECTOR, or
+   that it does not exist if SECTOR is 0.  The caller must hold the
+   lock of the directory inode. */
+void
+dcache_insert (block_sector_t dir, const char *name,
+               block_sector_t sector, bool is_dir)
+{
+  struct dentry *d;
+
+  if (strlen (name) > NAME_MAX)
+    return;
+
+  lock_acquire_re (&dcache_lock);
+  d = dentry_find (dir, name);
+  if (d == NULL)
+    {
+      if (hash_size (&dcache) >= DCACHE_SIZE)
+        dentry_free (list_entry (list_front (&dcache_lru),
+                                 struct dentry, lru_elem));
+      d = malloc (sizeof *d);
+      if (d == NULL)
+        goto done;
+      d->dir = dir;
+      strlcpy (d->name, name, sizeof d->name);
+      hash_insert (&dcache, &d->elem);
+    }
+  else
+    list_remove (&d->lru_elem);
+  d->sector = sector;
+  d->is_dir = is_dir;
+  list_push_back (&dcache_lru, &d->lru_elem);
+ done:
+  lock_release_re (&dcache_lock);
+}
+
+/* Forgets what is known about NAME in directory DIR. */
+void
+dcache_invalidate (block_sector_t dir, const char *name)
+{
+  struct dentry *d;
+
+  lock_acquire_re (&dcache_lock);
+  d = dentry_find (dir, name);
+  if (d != NULL)
+    dentry_free (d);
+  lock_release_re (&dcache_lock);
+}
+
+/* Forgets all entries of directory DIR. */
+void
+dcache_invalidate_dir (block_sector_t dir)
+{
+  struct list_elem *e, *next;
+
+  lock_acquire_re (&dcache_lock);
+  for (e = list_begin (&dcache_lru); e != list_end (&dcache_lru); e = next)
+    {
+      struct dentry *d = list_entry (e, struct dentry, lru_elem);
+      next = list_next (e);
+      if (d->dir == dir)
+        dentry_free (d);
+    }
+  lock_release_re (&dcache_lock);
+}
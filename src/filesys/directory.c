@@ -1,11 +1,17 @@
 #include "filesys/directory.h"
+#include <hash.h>
 #include <stdio.h>
+#include <stdint.h>
 #include <string.h>
+#include <round.h>
 #include <list.h>
+#include "filesys/cache.h"
+#include "filesys/dcache.h"
 #include "filesys/filesys.h"
 #include "filesys/file.h"
 #include "filesys/file-struct.h"
 #include "filesys/inode.h"
+#include "filesys/journal.h"
 #include "threads/malloc.h"
 #include "threads/thread.h"
 
@@ -15,6 +21,58 @@ struct file_entry
     block_sector_t inode_sector;        /* Sector number of header. */
     char name[NAME_MAX + 1];            /* Null terminated file name. */
     bool in_use;                        /* In use or free? */
+    bool is_dir;                        /* Is the file a directory? */
+  };
+
+/* Directories start out as a plain array of entries which is
+   searched linearly.  Once a directory holds more than
+   DIR_LINEAR_MAX entries it is turned into a hash table:
+
+   - Slot 0 holds a struct dir_header instead of an entry.
+   - Slots 1 to slot_cnt hold the entries, placed by the hash of
+     their name with linear probing.
+   - No slot crosses a sector boundary, so a lookup usually reads a
+     single sector.
+   - A removed entry stays behind as a tombstone, not in use but
+     with its inode_sector set, so probing continues past it.  A slot
+     that was never used has inode_sector 0.
+   - The table is rebuilt at twice the size when slots in use and
+     tombstones fill three quarters of it.
+   - Removals rebuild the table once tombstones fill a quarter of it
+     or entries fall below an eighth, at a size fitting the entries,
+     and turn it back into a linear directory when at most half of
+     DIR_LINEAR_MAX entries are left.  The sectors past the new end
+     are freed.
+   - A rebuild that fails for lack of memory or disk space leaves
+     the directory as it was.  An insertion then still goes into the
+     old layout if it has room, a linear directory always has.
+   - A rebuild moves entries to other slots, which would make a
+     listing in progress skip or repeat entries.  So while a handle
+     of the directory is in the middle of a listing, linear
+     directories keep growing linearly, hash tables fill up
+     completely without growing, and removals leave tombstones.
+     Once the table is full, entries go to overflow slots behind it,
+     which are searched linearly.  A listing ends when it reaches
+     the end of the directory or its handle is closed, and the last
+     one to end catches up on the rebuild. */
+#define DIR_LINEAR_MAX 25
+#define DIR_HASH_MIN_SLOTS 64
+#define DIR_HASH_MAGIC 0xfffffffe
+
+/* Number of slots per sector in a hashed directory. */
+#define SLOTS_PER_SECTOR (BLOCK_SECTOR_SIZE / sizeof (struct file_entry))
+
+/* Slot 0 of a hashed directory.  Looks like a free entry to code
+   that does not know about it. */
+struct dir_header
+  {
+    block_sector_t magic;               /* DIR_HASH_MAGIC. */
+    uint32_t slot_cnt;                  /* Number of entry slots. */
+    uint32_t entry_cnt;                 /* Slots in use. */
+    uint32_t tomb_cnt;                  /* Tombstones. */
+    uint8_t unused[3];
+    bool in_use;                        /* Always false. */
+    uint32_t ovfl_cnt;                  /* Overflow slots used. */
   };
 
 /* Creates a directory with space for ENTRY_CNT entries in the
@@ -35,6 +93,7 @@ dir_open (struct inode *inode)
     {
       dir->inode = inode;
       dir->pos = 0;
+      dir->listing = false;
       return dir;
     }
   else
@@ -88,12 +147,15 @@ dir_reopen (struct file *dir)
   return tmp;
 }
 
+static void listing_end (struct file *dir);
+
 /* Destroys DIR and frees associated resources. */
 void
 dir_close (struct file *dir)
 {
   if (dir != NULL)
     {
+      listing_end (dir);
       if (!file_isroot(dir)) {
         // dir is not the root node
         dir_close(dir->parent);
@@ -110,6 +172,126 @@ dir_get_inode (struct file *dir)
   return dir->inode;
 }
 
+/* Returns the byte offset of SLOT in a hashed directory. */
+static off_t
+slot_ofs (size_t slot)
+{
+  return slot / SLOTS_PER_SECTOR * BLOCK_SECTOR_SIZE
+         + slot % SLOTS_PER_SECTOR * sizeof (struct file_entry);
+}
+
+/* Reads the header of DIR into *H.
+   Returns true if DIR is hashed, false if it is a linear
+   directory. */
+static bool
+read_header (const struct file *dir, struct dir_header *h)
+{
+  ASSERT (sizeof *h == sizeof (struct file_entry));
+  return inode_read_at (dir->inode, h, sizeof *h, 0) == sizeof *h
+         && !h->in_use && h->magic == DIR_HASH_MAGIC;
+}
+
+static bool
+write_header (struct file *dir, struct dir_header *h)
+{
+  return inode_write_at (dir->inode, h, sizeof *h, 0) == sizeof *h;
+}
+
+/* Reads the entry at *POS of DIR into *E and advances *POS to the
+   next entry.  HASHED tells the layout of DIR.
+   Returns false at the end of DIR. */
+static bool
+read_entry (const struct file *dir, bool hashed, off_t *pos,
+            struct file_entry *e)
+{
+  if (hashed && *pos % BLOCK_SECTOR_SIZE + sizeof *e > BLOCK_SECTOR_SIZE)
+    *pos = ROUND_UP (*pos, BLOCK_SECTOR_SIZE);
+  if (inode_read_at (dir->inode, e, sizeof *e, *pos) != sizeof *e)
+    return false;
+  *pos += sizeof *e;
+  return true;
+}
+
+/* Probes the hash table of DIR with header H for NAME.
+   If found, returns true, sets *EP to the directory entry if EP is
+   non-null and *OFSP to its byte offset if OFSP is non-null.
+   Otherwise returns false.  If FREEP is non-null, stores the offset
+   of the first unused slot on the way into *FREEP, or -1 if there
+   is none. */
+static bool
+hash_probe (const struct file *dir, const struct dir_header *h,
+            const char *name, struct file_entry *ep, off_t *ofsp,
+            off_t *freep)
+{
+  struct file_entry entries[SLOTS_PER_SECTOR];
+  size_t slot = hash_string (name) % h->slot_cnt + 1;
+  size_t loaded = SIZE_MAX;
+  size_t i;
+
+  if (freep != NULL)
+    *freep = -1;
+  for (i = 0; i < h->slot_cnt; i++, slot = slot % h->slot_cnt + 1)
+    {
+      struct file_entry *e = &entries[slot % SLOTS_PER_SECTOR];
+      if (slot / SLOTS_PER_SECTOR != loaded)
+        {
+          loaded = slot / SLOTS_PER_SECTOR;
+          if (inode_read_at (dir->inode, entries, sizeof entries,
+                             loaded * BLOCK_SECTOR_SIZE) != sizeof entries)
+            return false;
+        }
+      if (e->in_use)
+        {
+          if (strcmp (name, e->name))
+            continue;
+          if (ep != NULL)
+            *ep = *e;
+          if (ofsp != NULL)
+            *ofsp = slot_ofs (slot);
+          return true;
+        }
+      if (freep != NULL && *freep < 0)
+        *freep = slot_ofs (slot);
+      if (e->inode_sector == 0)
+        break;
+    }
+  return false;
+}
+
+/* Searches the overflow slots of hashed directory DIR with header H,
+   the ones behind its table, for NAME like hash_probe().  If FREEP
+   is non-null and *FREEP is -1, stores the offset of the first
+   overflow slot not in use into it, or of the one behind the last
+   if all are. */
+static bool
+overflow_probe (const struct file *dir, const struct dir_header *h,
+                const char *name, struct file_entry *ep, off_t *ofsp,
+                off_t *freep)
+{
+  struct file_entry e;
+  size_t slot;
+
+  for (slot = h->slot_cnt + 1; slot <= h->slot_cnt + h->ovfl_cnt; slot++)
+    {
+      if (inode_read_at (dir->inode, &e, sizeof e, slot_ofs (slot))
+          != sizeof e)
+        return false;
+      if (e.in_use && !strcmp (name, e.name))
+        {
+          if (ep != NULL)
+            *ep = e;
+          if (ofsp != NULL)
+            *ofsp = slot_ofs (slot);
+          return true;
+        }
+      if (!e.in_use && freep != NULL && *freep < 0)
+        *freep = slot_ofs (slot);
+    }
+  if (freep != NULL && *freep < 0)
+    *freep = slot_ofs (slot);
+  return false;
+}
+
 /* Searches DIR for a file with the given NAME.
    If successful, returns true, sets *EP to the directory entry
    if EP is non-null, and sets *OFSP to the byte offset of the
@@ -119,12 +301,17 @@ static bool
 lookup (const struct file *dir, const char *name,
         struct file_entry *ep, off_t *ofsp)
 {
+  struct dir_header h;
   struct file_entry e;
   size_t ofs;
   
   ASSERT (dir != NULL);
   ASSERT (name != NULL);
 
+  if (read_header (dir, &h))
+    return hash_probe (dir, &h, name, ep, ofsp, NULL)
+           || overflow_probe (dir, &h, name, ep, ofsp, NULL);
+
   for (ofs = 0; inode_read_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
        ofs += sizeof e) 
     if (e.in_use && !strcmp (name, e.name)) 
@@ -138,38 +325,233 @@ lookup (const struct file *dir, const char *name,
   return false;
 }
 
+/* Puts entry E into hash table TABLE of SLOT_CNT slots, which is
+   held in memory and has a free slot left, at the first free slot a
+   lookup of its name probes. */
+static void
+table_put (uint8_t *table, size_t slot_cnt, const struct file_entry *e)
+{
+  size_t slot = hash_string (e->name) % slot_cnt + 1;
+  struct file_entry *t;
+
+  while ((t = (struct file_entry *) (table + slot_ofs (slot)))->in_use)
+    slot = slot % slot_cnt + 1;
+  *t = *e;
+}
+
+/* Turns DIR into a hash table of SLOT_CNT slots holding all entries
+   in use of DIR, which may be linear or hashed.  If SLOT_CNT is 0,
+   turns DIR into a linear directory instead.  DIR is truncated to
+   the new layout.
+   The new layout is built in memory.  The part of it past the old
+   end of DIR is written first, so the sectors that need allocating
+   are allocated while the old layout is still intact, and only then
+   is the rest written over the old layout.
+   Returns true if successful, false on failure, in which case DIR
+   is left as it was. */
+static bool
+rebuild (struct file *dir, size_t slot_cnt)
+{
+  struct dir_header h;
+  struct file_entry e, *entries;
+  bool hashed = read_header (dir, &h);
+  off_t old_size = inode_length (dir->inode);
+  uint8_t *image;
+  size_t cnt = 0, i;
+  off_t pos, size, head;
+  bool success = false;
+
+  /* Take all entries in use into memory */
+  for (pos = 0; read_entry (dir, hashed, &pos, &e); )
+    if (e.in_use)
+      cnt++;
+  entries = malloc (cnt * sizeof *entries + 1);
+  if (entries == NULL)
+    return false;
+  for (pos = 0, i = 0; i < cnt && read_entry (dir, hashed, &pos, &e); )
+    if (e.in_use)
+      entries[i++] = e;
+
+  if (slot_cnt == 0)
+    {
+      /* Linear, entries back to back */
+      image = (uint8_t *) entries;
+      size = cnt * sizeof e;
+    }
+  else
+    {
+      ASSERT (cnt < slot_cnt);
+      size = ROUND_UP (slot_ofs (slot_cnt) + sizeof e, BLOCK_SECTOR_SIZE);
+      image = calloc (1, size);
+      if (image == NULL)
+        goto done;
+      memset (&h, 0, sizeof h);
+      h.magic = DIR_HASH_MAGIC;
+      h.slot_cnt = slot_cnt;
+      h.entry_cnt = cnt;
+      memcpy (image, &h, sizeof h);
+      for (i = 0; i < cnt; i++)
+        table_put (image, slot_cnt, &entries[i]);
+    }
+
+  /* Grow first, dropping what was written if the disk is full */
+  head = size < old_size ? size : old_size;
+  if (inode_write_at (dir->inode, image + head, size - head, head)
+      != size - head)
+    {
+      inode_truncate (dir->inode, old_size);
+      goto done;
+    }
+  success = inode_write_at (dir->inode, image, head, 0) == head;
+
+  /* Drop old entries past the new end */
+  if (success)
+    inode_truncate (dir->inode, size);
+
+ done:
+  if (image != (uint8_t *) entries)
+    free (image);
+  free (entries);
+  return success;
+}
+
+/* Returns the number of slots of a hash table for ENTRY_CNT
+   entries, which fill at most half of it. */
+static size_t
+fit_slots (size_t entry_cnt)
+{
+  size_t slot_cnt = DIR_HASH_MIN_SLOTS;
+
+  while (entry_cnt * 2 > slot_cnt)
+    slot_cnt *= 2;
+  return slot_cnt;
+}
+
+/* Rebuilds hashed directory DIR with header H after a removal if it
+   has become sparse or full of tombstones or has overflowed, see
+   above.
+   Returns false if a rebuild was due and failed, which leaves DIR as
+   it was for a later removal to try again. */
+static bool
+compact (struct file *dir, const struct dir_header *h)
+{
+  if (h->entry_cnt <= DIR_LINEAR_MAX / 2)
+    return rebuild (dir, 0);
+  else if (h->ovfl_cnt > 0)
+    return rebuild (dir, fit_slots (h->entry_cnt));
+  else if (h->entry_cnt * 8 < h->slot_cnt
+           && h->slot_cnt > DIR_HASH_MIN_SLOTS)
+    return rebuild (dir, fit_slots (h->entry_cnt));
+  else if (h->tomb_cnt * 4 > h->slot_cnt)
+    return rebuild (dir, h->slot_cnt);
+  return true;
+}
+
+/* Does the rebuild of DIR that insertions or removals put off while
+   it was being listed, if any is due.
+   Returns false if it failed, which leaves DIR as it was for the
+   next insertion or removal to try again. */
+static bool
+catch_up (struct file *dir)
+{
+  struct dir_header h;
+  struct file_entry e;
+  size_t entry_cnt = 0;
+  off_t pos;
+
+  if (read_header (dir, &h))
+    {
+      if ((h.entry_cnt + h.tomb_cnt) * 4 > h.slot_cnt * 3)
+        return rebuild (dir, fit_slots (h.entry_cnt));
+      return compact (dir, &h);
+    }
+  for (pos = 0; read_entry (dir, false, &pos, &e); )
+    if (e.in_use)
+      entry_cnt++;
+  if (entry_cnt > DIR_LINEAR_MAX)
+    return rebuild (dir, fit_slots (entry_cnt));
+  return true;
+}
+
+/* Marks DIR as being in the middle of a listing, if not yet. */
+static void
+listing_begin (struct file *dir)
+{
+  if (dir->listing)
+    return;
+  dir->listing = true;
+  inode_list_begin (dir->inode);
+}
+
+/* Ends the listing in progress on DIR, if any.  The last listing of
+   a directory to end catches up on its rebuild. */
+static void
+listing_end (struct file *dir)
+{
+  if (!dir->listing)
+    return;
+  dir->listing = false;
+  journal_begin ();
+  inode_acquire (dir->inode);
+  /* A rebuild that fails stays due for the next insertion or
+     removal */
+  if (inode_list_end (dir->inode) && !inode_get_removed (dir->inode))
+    catch_up (dir);
+  inode_release (dir->inode);
+  journal_end ();
+}
+
 /* Searches DIR for a file with the given NAME
    and returns true if one exists, false otherwise.
    On success, sets *INODE to an inode for the file, otherwise to
-   a null pointer.  The caller must close *INODE. */
+   a null pointer.  The caller must close *INODE.  If IS_DIRP is
+   non-null, stores whether the file is a directory in it, which
+   comes from the directory entry and not from the inode. */
 bool
 dir_lookup (const struct file *dir, const char *name,
-            struct inode **inode) 
+            struct inode **inode, bool *is_dirp) 
 {
   struct file_entry e;
+  block_sector_t dir_sector, sector;
+  bool is_dir;
   inode_acquire(dir->inode);
   ASSERT (dir != NULL);
   ASSERT (name != NULL);
 
-  if (lookup (dir, name, &e, NULL))
-    *inode = inode_open (e.inode_sector);
+  dir_sector = inode_get_inumber (dir->inode);
+  if (dcache_lookup (dir_sector, name, &sector, &is_dir))
+    *inode = sector != 0 ? inode_open (sector) : NULL;
+  else if (lookup (dir, name, &e, NULL))
+    {
+      is_dir = e.is_dir;
+      *inode = inode_open (e.inode_sector);
+      dcache_insert (dir_sector, name, e.inode_sector, e.is_dir);
+    }
   else
-    *inode = NULL;
+    {
+      *inode = NULL;
+      dcache_insert (dir_sector, name, 0, false);
+    }
   inode_release(dir->inode);
+  if (is_dirp != NULL && *inode != NULL)
+    *is_dirp = is_dir;
   return *inode != NULL;
 }
 
 /* Adds a file named NAME to DIR, which must not already contain a
    file by that name.  The file's inode is in sector
-   INODE_SECTOR.
+   INODE_SECTOR, IS_DIR tells whether it is a directory.
    Returns true if successful, false on failure.
    Fails if NAME is invalid (i.e. too long) or a disk or memory
    error occurs. */
 bool
-dir_add (struct file *dir, const char *name, block_sector_t inode_sector)
+dir_add (struct file *dir, const char *name, block_sector_t inode_sector,
+         bool is_dir)
 {
+  struct dir_header h;
   struct file_entry e;
-  off_t ofs;
+  size_t entry_cnt = 0;
+  off_t ofs, pos;
   bool success = false;
 
   ASSERT (dir != NULL);
@@ -180,29 +562,78 @@ dir_add (struct file *dir, const char *name, block_sector_t inode_sector)
     return false;
 
   inode_acquire(dir->inode);
-  /* Check that NAME is not in use. */
-  if (lookup (dir, name, NULL, NULL))
-    goto done;
+  if (read_header (dir, &h))
+    goto hashed;
 
-  /* Set OFS to offset of free slot.
+  /* Check that NAME is not in use, counting the entries and setting
+     OFS to the offset of the first free slot on the way.
      If there are no free slots, then it will be set to the
      current end-of-file.
      
      inode_read_at() will only return a short read at end of file.
      Otherwise, we'd need to verify that we didn't get a short
      read due to something intermittent such as low memory. */
-  for (ofs = 0; inode_read_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
-       ofs += sizeof e) 
+  ofs = -1;
+  for (pos = 0; inode_read_at (dir->inode, &e, sizeof e, pos) == sizeof e;
+       pos += sizeof e) 
     if (!e.in_use)
-      break;
+      {
+        if (ofs < 0)
+          ofs = pos;
+      }
+    else if (!strcmp (name, e.name))
+      goto done;
+    else
+      entry_cnt++;
+  if (ofs < 0)
+    ofs = pos;
+
+  /* Too large to search linearly, stays linear if the rebuild
+     fails */
+  if (entry_cnt < DIR_LINEAR_MAX || inode_listed (dir->inode)
+      || !rebuild (dir, fit_slots (entry_cnt + 1)))
+    {
+      /* Write slot. */
+      e.in_use = true;
+      strlcpy (e.name, name, sizeof e.name);
+      e.inode_sector = inode_sector;
+      e.is_dir = is_dir;
+      success = inode_write_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
+      goto done;
+    }
+  if (!read_header (dir, &h))
+    goto done;
 
-  /* Write slot. */
+ hashed:
+  if (hash_probe (dir, &h, name, NULL, NULL, &ofs)
+      || overflow_probe (dir, &h, name, NULL, NULL, &ofs))
+    goto done;
+  if ((h.entry_cnt + h.tomb_cnt + 1) * 4 > h.slot_cnt * 3
+      && !inode_listed (dir->inode))
+    {
+      /* Grow, which also drops the tombstones.  If that fails the
+         table is unchanged and the entry may still fit into it */
+      if (rebuild (dir, h.slot_cnt * 2) && read_header (dir, &h))
+        hash_probe (dir, &h, name, NULL, NULL, &ofs);
+    }
+  /* A new overflow slot lies past the end of DIR */
+  if (inode_read_at (dir->inode, &e, sizeof e, ofs) != sizeof e)
+    memset (&e, 0, sizeof e);
+  if (ofs == slot_ofs (h.slot_cnt + h.ovfl_cnt + 1))
+    h.ovfl_cnt++;
+  if (e.inode_sector != 0)
+    h.tomb_cnt--;
+  h.entry_cnt++;
   e.in_use = true;
   strlcpy (e.name, name, sizeof e.name);
   e.inode_sector = inode_sector;
-  success = inode_write_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
+  e.is_dir = is_dir;
+  success = inode_write_at (dir->inode, &e, sizeof e, ofs) == sizeof e
+            && write_header (dir, &h);
 
  done:
+  if (success)
+    dcache_invalidate (inode_get_inumber (dir->inode), name);
   inode_release(dir->inode);
   return success;
 }
@@ -213,6 +644,7 @@ dir_add (struct file *dir, const char *name, block_sector_t inode_sector)
 bool
 dir_remove (struct file *dir, const char *name)
 {
+  struct dir_header h;
   struct file_entry e;
   struct inode *inode = NULL;
   bool success = false;
@@ -231,14 +663,38 @@ dir_remove (struct file *dir, const char *name)
   if (inode == NULL)
     goto done;
 
-  /* Erase directory entry. */
+  /* Erase directory entry, leaves a tombstone. */
   e.in_use = false;
   if (inode_write_at (dir->inode, &e, sizeof e, ofs) != sizeof e) 
     goto done;
+  if (read_header (dir, &h))
+    {
+      h.entry_cnt--;
+      h.tomb_cnt++;
+      write_header (dir, &h);
+      /* The entry is gone even if the table stays as it is */
+      if (!inode_listed (dir->inode))
+        compact (dir, &h);
+    }
+  else if (ofs + (off_t) sizeof e == inode_length (dir->inode))
+    {
+      /* Last entry of a linear directory, drop the free slots at the
+         end */
+      struct file_entry prev;
+      while (ofs > 0
+             && inode_read_at (dir->inode, &prev, sizeof prev,
+                               ofs - sizeof prev) == sizeof prev
+             && !prev.in_use)
+        ofs -= sizeof prev;
+      inode_truncate (dir->inode, ofs);
+    }
 
   /* Remove inode. */
   inode_remove (inode);
   success = true;
+  dcache_invalidate (inode_get_inumber (dir->inode), name);
+  if (e.is_dir)
+    dcache_invalidate_dir (e.inode_sector);
 
  done:
   inode_release(dir->inode);
@@ -246,24 +702,126 @@ dir_remove (struct file *dir, const char *name)
   return success;
 }
 
+/* Stat-ahead for listings: queues the inode sectors of the entries
+   of DIR that start in the same sector as the one at OFS, which must
+   be the first of them, to be prefetched into the cache.  HASHED
+   tells the layout of DIR.  Programs that list a directory usually
+   open or stat the entries next. */
+static void
+stat_ahead (const struct file *dir, bool hashed, off_t ofs)
+{
+  struct file_entry entries[SLOTS_PER_SECTOR + 1];
+  block_sector_t sectors[SLOTS_PER_SECTOR + 1];
+  size_t cnt, i, n = 0;
+
+  if (hashed)
+    cnt = SLOTS_PER_SECTOR;
+  else
+    cnt = DIV_ROUND_UP (BLOCK_SECTOR_SIZE - ofs % BLOCK_SECTOR_SIZE,
+                        sizeof *entries);
+  cnt = inode_read_at (dir->inode, entries, cnt * sizeof *entries, ofs)
+        / sizeof *entries;
+  for (i = 0; i < cnt; i++)
+    if (entries[i].in_use)
+      sectors[n++] = entries[i].inode_sector;
+  cache_prefetch (sectors, n);
+}
+
 /* Reads the next directory entry in DIR and stores the name in
    NAME.  Returns true if successful, false if the directory
    contains no more entries. */
 bool
 dir_readdir (struct file *dir, char name[NAME_MAX + 1])
 {
+  struct dir_header h;
   struct file_entry e;
+  bool hashed, success = false;
 
-  while (inode_read_at (dir->inode, &e, sizeof e, dir->pos) == sizeof e) 
+  inode_acquire (dir->inode);
+  listing_begin (dir);
+  hashed = read_header (dir, &h);
+  while (read_entry (dir, hashed, &dir->pos, &e))
     {
-      dir->pos += sizeof e;
+      off_t ofs = dir->pos - sizeof e;
+      if (ofs % BLOCK_SECTOR_SIZE < (off_t) sizeof e)
+        stat_ahead (dir, hashed, ofs);
       if (e.in_use)
         {
           strlcpy (name, e.name, NAME_MAX + 1);
-          return true;
+          success = true;
+          break;
         } 
     }
-  return false;
+  inode_release (dir->inode);
+  if (!success)
+    listing_end (dir);
+  return success;
+}
+
+/* Reads entries from DIR into RECORDS, up to CNT of them, starting
+   at the current position and reading a sector's worth of slots at
+   a time.  No inode of an entry is opened, their sectors are
+   prefetched instead.  Returns the number of records filled in, which is 0 at
+   the end of DIR. */
+size_t
+dir_readdir_batch (struct file *dir, struct dir_record *records, size_t cnt)
+{
+  struct file_entry entries[SLOTS_PER_SECTOR];
+  struct dir_header h;
+  bool hashed, eof = false;
+  size_t n = 0;
+
+  inode_acquire (dir->inode);
+  listing_begin (dir);
+  hashed = read_header (dir, &h);
+  while (n < cnt)
+    {
+      size_t first = 0, slot_cnt, i;
+
+      if (hashed)
+        {
+          if (dir->pos % BLOCK_SECTOR_SIZE + sizeof *entries > BLOCK_SECTOR_SIZE)
+            dir->pos = ROUND_UP (dir->pos, BLOCK_SECTOR_SIZE);
+          first = dir->pos % BLOCK_SECTOR_SIZE / sizeof *entries;
+        }
+      slot_cnt = inode_read_at (dir->inode, entries + first,
+                                (SLOTS_PER_SECTOR - first) * sizeof *entries,
+                                dir->pos) / sizeof *entries;
+      if (slot_cnt == 0)
+        {
+          eof = true;
+          break;
+        }
+
+      for (i = first; i < first + slot_cnt && n < cnt; i++)
+        {
+          struct file_entry *e = &entries[i];
+          struct dir_record *r;
+
+          dir->pos += sizeof *e;
+          if (!e->in_use)
+            continue;
+
+          r = &records[n++];
+          r->sector = e->inode_sector;
+          r->is_dir = e->is_dir;
+          strlcpy (r->name, e->name, sizeof r->name);
+        }
+    }
+  inode_release (dir->inode);
+  if (eof)
+    listing_end (dir);
+
+  /* Prefetch in chunks, the kernel stack is small */
+  size_t i, j;
+  for (i = 0; i < n; i += j)
+    {
+      block_sector_t sectors[SLOTS_PER_SECTOR];
+      for (j = 0; j < SLOTS_PER_SECTOR && i + j < n; j++)
+        sectors[j] = records[i + j].sector;
+      cache_prefetch (sectors, j);
+    }
+  return n;
 }
 
 struct file *
@@ -281,6 +839,7 @@ dir_pop (struct file *dir) {
   }
 
   struct file *tmp = dir->parent;
+  listing_end(dir);
   inode_close(dir->inode);
   free(dir);
   return tmp;
@@ -14,6 +14,14 @@
 struct inode;
 struct file;
 
+/* A directory entry as returned by dir_readdir_batch(). */
+struct dir_record
+  {
+    block_sector_t sector;              /* Sector of the entry's inode. */
+    bool is_dir;                        /* Is the entry a directory? */
+    char name[NAME_MAX + 1];            /* Null terminated file name. */
+  };
+
 /* Opening and closing directories. */
 bool dir_create (block_sector_t sector, size_t entry_cnt);
 struct file *dir_open (struct inode *);
@@ -25,10 +33,12 @@ void dir_close (struct file *);
 struct inode *dir_get_inode (struct file *);
 
 /* Reading and writing. */
-bool dir_lookup (const struct file *, const char *name, struct inode **);
-bool dir_add (struct file *, const char *name, block_sector_t);
+bool dir_lookup (const struct file *, const char *name, struct inode **,
+                 bool *is_dir);
+bool dir_add (struct file *, const char *name, block_sector_t, bool is_dir);
 bool dir_remove (struct file *, const char *name);
 bool dir_readdir (struct file *, char name[NAME_MAX + 1]);
+size_t dir_readdir_batch (struct file *, struct dir_record *, size_t cnt);
 
 struct file * dir_get_parent (struct file *dir);
 struct file * dir_pop (struct file *dir);
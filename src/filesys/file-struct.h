@@ -10,6 +10,8 @@ struct file
     struct inode *inode;        /* File's inode. */
     off_t pos;                  /* Current position. */
     bool deny_write;            /* Has file_deny_write() been called? */
+    bool direct;                /* Bypass the cache, see file_set_direct(). */
+    bool listing;               /* Directory listing begun, see dir_readdir(). */
     struct file *parent;        /* parent node */
   };
 
@@ -22,6 +22,8 @@ file_open (struct inode *inode)
       file->inode = inode;
       file->pos = 0;
       file->deny_write = false;
+      file->direct = false;
+      file->listing = false;
       res = file;
     }
   else
@@ -72,7 +74,7 @@ off_t
 file_read (struct file *file, void *buffer, off_t size) 
 {
 
-  off_t bytes_read = inode_read_at (file->inode, buffer, size, file->pos);
+  off_t bytes_read = file_read_at (file, buffer, size, file->pos);
   file->pos += bytes_read;
 
   return bytes_read;
@@ -86,7 +88,9 @@ file_read (struct file *file, void *buffer, off_t size)
 off_t
 file_read_at (struct file *file, void *buffer, off_t size, off_t file_ofs) 
 {
-  off_t bytes_read = inode_read_at (file->inode, buffer, size, file_ofs);
+  off_t bytes_read = file->direct
+                     ? inode_read_at_direct (file->inode, buffer, size, file_ofs)
+                     : inode_read_at (file->inode, buffer, size, file_ofs);
 
   return bytes_read;
 }
@@ -102,7 +106,7 @@ off_t
 file_write (struct file *file, const void *buffer, off_t size) 
 {
 
-  off_t bytes_written = inode_write_at (file->inode, buffer, size, file->pos);
+  off_t bytes_written = file_write_at (file, buffer, size, file->pos);
   file->pos += bytes_written;
 
   return bytes_written;
@@ -120,11 +124,53 @@ file_write_at (struct file *file, const void *buffer, off_t size,
                off_t file_ofs) 
 {
 
-  off_t bytes_written = inode_write_at (file->inode, buffer, size, file_ofs);
+  off_t bytes_written = file->direct
+    ? inode_write_at_direct (file->inode, (void *) buffer, size, file_ofs)
+    : inode_write_at (file->inode, (void *) buffer, size, file_ofs);
 
   return bytes_written;
 }
 
+/* Makes reads and writes of whole sectors through FILE bypass the
+   cache if DIRECT is true, or go through it again if false.  Meant
+   for large sequential transfers, which would otherwise evict the
+   cached sectors of everyone else.  Other openers of the same file
+   are not affected and see the same data either way. */
+void
+file_set_direct (struct file *file, bool direct)
+{
+  ASSERT (file != NULL);
+  file->direct = direct;
+}
+
+/* Reserves disk space for SIZE bytes of FILE starting at
+   FILE_OFS, extending the file if necessary.  The reserved range
+   reads as zeros and later writes to it need no allocation.
+   Returns true if successful, false if the disk is full or writes
+   are denied.
+   The file's current position is unaffected. */
+bool
+file_allocate (struct file *file, off_t file_ofs, off_t size)
+{
+  ASSERT (file != NULL);
+  if (file_ofs < 0 || size < 0 || size > INT32_MAX - file_ofs)
+    return false;
+  return inode_allocate (file->inode, file_ofs, size);
+}
+
+/* Returns the offset of the next byte at or after FILE_OFS that
+   lies in a hole of FILE if HOLE is true, or that holds data if
+   HOLE is false.  The end of the file counts as a hole.
+   Returns -1 if there is no such byte.
+   The file's current position is unaffected. */
+off_t
+file_seek_data (struct file *file, off_t file_ofs, bool hole)
+{
+  ASSERT (file != NULL);
+  ASSERT (file_ofs >= 0);
+  return inode_seek_data (file->inode, file_ofs, hole);
+}
+
 /* Prevents write operations on FILE's underlying inode
    until file_allow_write() is called or FILE is closed. */
 void
@@ -226,6 +272,7 @@ file_deconstruct_path (const char   *path,
    //printf("PATH: %s\n", path);
   struct file *dir, *f = NULL;
   struct inode *inode;
+  bool is_dir;
   if(s[0] == '/' || !thread_current()->current_work_dir) {
     dir = dir_open_root();
 
@@ -256,9 +303,14 @@ file_deconstruct_path (const char   *path,
       goto next;
     }
 
-    if (!dir_lookup(dir, token, &inode)) {
+    if (!dir_lookup(dir, token, &inode, &is_dir)) {
       break;
     }
+    if (!is_dir) {
+      // a file in the middle of the path
+      inode_close(inode);
+      goto done;
+    }
     dir = dir_open_with_parent(inode, dir);
 
 next:
@@ -279,8 +331,8 @@ after_loop:
       f = dir_reopen(dir);
     } else if (strcmp(token, "..") == 0) {
       f = dir_reopen(dir->parent);
-    } else if (dir_lookup(dir, token, &inode)) {
-        if (inode_isdir(inode)) {
+    } else if (dir_lookup(dir, token, &inode, &is_dir)) {
+        if (is_dir) {
          f = dir_open_with_parent(inode, dir);
       } else {
         f = file_open(inode);
@@ -18,6 +18,9 @@ off_t file_read (struct file *, void *, off_t);
 off_t file_read_at (struct file *, void *, off_t size, off_t start);
 off_t file_write (struct file *, const void *, off_t);
 off_t file_write_at (struct file *, const void *, off_t size, off_t start);
+void file_set_direct (struct file *, bool direct);
+bool file_allocate (struct file *, off_t start, off_t size);
+off_t file_seek_data (struct file *, off_t start, bool hole);
 
 /* Preventing writes. */
 void file_deny_write (struct file *);
@@ -2,14 +2,20 @@
 #include <debug.h>
 #include <stdio.h>
 #include <string.h>
+#include "filesys/dcache.h"
 #include "filesys/file.h"
 #include "filesys/free-map.h"
 #include "filesys/inode.h"
 #include "filesys/directory.h"
+#include "filesys/journal.h"
+#include "threads/thread.h"
 
 /* Partition that contains the file system. */
 struct block *fs_device;
 
+/* See filesys.h. */
+bool filesys_compress;
+
 static void do_format (void);
 
 /* Initializes the file system module.
@@ -21,7 +27,9 @@ filesys_init (bool format)
   if (fs_device == NULL)
     PANIC ("No file system device found, can't initialize file system.");
 
+  journal_init (format);
   inode_init ();
+  dcache_init ();
   free_map_init ();
 
   if (format) 
@@ -36,7 +44,10 @@ void
 filesys_done (void) 
 {
   // TODO flush cache
+  inode_reclaim_wait ();
+  free_map_return (&thread_current ()->fs_reserve);
   free_map_close ();
+  journal_commit ();
 }
 
 /* Creates a file named NAME with the given INITIAL_SIZE.
@@ -55,13 +66,20 @@ filesys_create (const char *path,
   if (!file_deconstruct_path(path, &parent, NULL, &dirname) || parent == NULL) {
     return false;
   }
+  /* Keep files close to their directory, spread directories over the
+     block groups. */
+  block_sector_t goal = inode_get_inumber (dir_get_inode (parent));
+  if (isdir)
+    goal = free_map_next_group (goal);
   block_sector_t inode_sector = 0;
-  success = (free_map_allocate (1, &inode_sector)
+  journal_begin ();
+  success = (free_map_allocate_reserved (goal, &inode_sector)
                   && inode_create (inode_sector, initial_size, isdir)
-                  && dir_add (parent, dirname, inode_sector));
+                  && dir_add (parent, dirname, inode_sector, isdir));
   if (!success && inode_sector != 0)
     free_map_release (inode_sector, 1);
   dir_close (parent);
+  journal_end ();
   return success;
 }
 
@@ -95,6 +113,7 @@ filesys_remove (const char *path)
     return false;
   }
 
+  journal_begin ();
   bool success = !file_isroot(f) && dir_remove (dir, fname);
   dir_close (dir);
   if (file_isdir(f)) {
@@ -102,6 +121,39 @@ filesys_remove (const char *path)
   } else {
     dir_close(f);
   }
+  journal_end ();
+  return success;
+}
+
+/* Creates a file named NEW_PATH with the contents of the file named
+   PATH.  Both files share their data sectors until they are written.
+   Returns true if successful, false otherwise.
+   Fails if PATH is not a regular file, if a file named NEW_PATH
+   already exists or if the disk is full. */
+bool
+filesys_clone (const char *path, const char *new_path)
+{
+  struct file *src, *dst;
+  bool success = false;
+
+  src = filesys_open (path);
+  if (src == NULL)
+    return false;
+  journal_begin ();
+  if (!file_isdir (src) && filesys_create (new_path, 0, false)) {
+    dst = filesys_open (new_path);
+    if (dst != NULL)
+      success = inode_clone (file_get_inode (dst), file_get_inode (src));
+    if (!success)
+      filesys_remove (new_path);
+    file_close (dst);
+  }
+  journal_end ();
+  if (file_isdir (src)) {
+    dir_close (src);
+  } else {
+    file_close (src);
+  }
   return success;
 }
 
@@ -113,6 +165,7 @@ do_format (void)
   free_map_create ();
   if (!dir_create (ROOT_DIR_SECTOR, 16))
     PANIC ("root directory creation failed");
+  free_map_return (&thread_current ()->fs_reserve);
   free_map_close ();
   printf ("done.\n");
 }
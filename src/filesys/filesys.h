@@ -8,6 +8,8 @@
 /* Sectors of system file inodes. */
 #define FREE_MAP_SECTOR 0       /* Free map file inode sector. */
 #define ROOT_DIR_SECTOR 1       /* Root directory file inode sector. */
+#define REFCOUNT_SECTOR 2       /* Reference count map inode sector. */
+#define JOURNAL_SECTOR 3        /* First sector of the journal. */
 
 /* Block device that contains the file system. */
 struct block *fs_device;
@@ -16,6 +18,11 @@ struct block *fs_device;
 // before performing any action
 struct lock fs_lock;
 
+/* Compress the data of files created from now on, set by the
+   -o=compress kernel option.  The setting is kept per file, so
+   files written before stay readable either way. */
+extern bool filesys_compress;
+
 void filesys_init (bool format);
 void filesys_done (void);
 bool filesys_create (const char *name,
@@ -23,5 +30,6 @@ bool filesys_create (const char *name,
                      bool        isdir);
 struct file *filesys_open (const char *name);
 bool filesys_remove (const char *name);
+bool filesys_clone (const char *name, const char *new_name);
 
 #endif /* filesys/filesys.h */
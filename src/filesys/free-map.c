@@ -1,14 +1,84 @@
 #include "filesys/free-map.h"
 #include <bitmap.h>
+#include <avl.h>
 #include <debug.h>
+#include <round.h>
+#include <stdint.h>
 #include "filesys/file.h"
 #include "filesys/filesys.h"
 #include "filesys/inode.h"
+#include "filesys/journal.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
 
 static struct file *free_map_file;   /* Free map file. */
 static struct bitmap *free_map;      /* Free map, one bit per sector. */
 
-// TODO locks
+/* Reference count map, one byte per sector holding the number of
+   additional owners of a data sector shared by cloned files.  Zero
+   for sectors with a single owner.  Read and written through the
+   cache, the file is fully preallocated so updating it never
+   allocates sectors. */
+static struct file *refcount_file;
+
+/* Protects the free map, sectors are released from the reclaim
+   thread as well. */
+static struct lock free_map_lock;
+
+/* Number of free map bits stored in one sector of the free map
+   file. */
+#define BITS_PER_SECTOR (BLOCK_SECTOR_SIZE * 8)
+
+/* Sectors of the free map file that differ from the in-memory free
+   map, one bit per sector.  Only these are written back, into the
+   cache which writes them to disk. */
+static struct bitmap *free_map_changed;
+
+/* Sectors per block group.  Files are allocated close to their
+   inode, inodes close to their directory and directories are spread
+   over the groups. */
+#define BLOCK_GROUP_SECTORS BITS_PER_SECTOR
+
+/* Number of sectors a thread reserves at once for metadata. */
+#define RESERVE_SECTORS 8
+
+/* Number of free extents behind the goal of an allocation looked at
+   before falling back to the best fit. */
+#define EXTENT_WALK_MAX 64
+
+/* Where allocations without a goal continue searching. */
+static block_sector_t free_map_cursor;
+
+/* Number of open release batches.  While non-zero, releases only
+   update the in-memory bitmap and free_map_changed. */
+static int release_batch_cnt;
+
+/* Free extent index.
+
+   Every maximal run of free sectors is kept in two balanced trees.
+   The one ordered by first sector finds the extent around a sector,
+   the next ones behind it and the neighbours that released sectors
+   merge with.  The one ordered by size finds the smallest extent that
+   fits a request when none close to its goal does.  All of these take
+   O(log n) time.
+
+   The index is built from the bitmap when the free map is opened.
+   Until then, or after running out of memory, allocations scan the
+   bitmap instead. */
+struct free_extent
+  {
+    struct avl_elem start_elem;         /* In extents_by_start. */
+    struct avl_elem size_elem;          /* In extents_by_size. */
+    block_sector_t start;               /* First free sector. */
+    size_t cnt;                         /* Number of free sectors. */
+  };
+
+static bool extents_valid;
+static struct avl extents_by_start;
+static struct avl extents_by_size;
+
+static avl_less_func extent_start_less, extent_size_less;
 
 /* Initializes the free map. */
 void
@@ -19,37 +89,560 @@ free_map_init (void)
     PANIC ("bitmap creation failed--file system device is too large");
   bitmap_mark (free_map, FREE_MAP_SECTOR);
   bitmap_mark (free_map, ROOT_DIR_SECTOR);
+  bitmap_mark (free_map, REFCOUNT_SECTOR);
+  bitmap_set_multiple (free_map, JOURNAL_SECTOR, JOURNAL_SECTORS, true);
+  free_map_changed = bitmap_create (DIV_ROUND_UP (bitmap_file_size (free_map),
+                                                  BLOCK_SECTOR_SIZE));
+  if (free_map_changed == NULL)
+    PANIC ("bitmap creation failed--file system device is too large");
+  lock_init (&free_map_lock);
+
+  avl_init (&extents_by_start, extent_start_less, NULL);
+  avl_init (&extents_by_size, extent_size_less, NULL);
+}
+
+static bool
+extent_start_less (const struct avl_elem *a, const struct avl_elem *b,
+                   void *aux UNUSED)
+{
+  return avl_entry (a, struct free_extent, start_elem)->start
+         < avl_entry (b, struct free_extent, start_elem)->start;
+}
+
+/* Orders extents by size, equal sizes by their first sector. */
+static bool
+extent_size_less (const struct avl_elem *a_, const struct avl_elem *b_,
+                  void *aux UNUSED)
+{
+  const struct free_extent *a = avl_entry (a_, struct free_extent, size_elem);
+  const struct free_extent *b = avl_entry (b_, struct free_extent, size_elem);
+
+  if (a->cnt != b->cnt)
+    return a->cnt < b->cnt;
+  return a->start < b->start;
+}
+
+/* Returns the sector behind extent E. */
+static block_sector_t
+extent_end (const struct free_extent *e)
+{
+  return e->start + e->cnt;
+}
+
+/* Adds E to the index.  Its start and cnt must not change while it
+   is in there. */
+static void
+extent_link (struct free_extent *e)
+{
+  avl_insert (&extents_by_start, &e->start_elem);
+  avl_insert (&extents_by_size, &e->size_elem);
+}
+
+/* Removes E from the index. */
+static void
+extent_unlink (struct free_extent *e)
+{
+  avl_remove (&extents_by_start, &e->start_elem);
+  avl_remove (&extents_by_size, &e->size_elem);
+}
+
+/* Frees the whole index and falls back to scanning the bitmap. */
+static void
+extents_drop (void)
+{
+  while (!avl_empty (&extents_by_start))
+    {
+      struct free_extent *e = avl_entry (avl_first (&extents_by_start),
+                                         struct free_extent, start_elem);
+      extent_unlink (e);
+      free (e);
+    }
+  extents_valid = false;
+}
+
+/* Adds a new extent of CNT sectors at START to the index.  Drops the
+   index if memory is short. */
+static void
+extent_add (block_sector_t start, size_t cnt)
+{
+  struct free_extent *e = malloc (sizeof *e);
+  if (e == NULL)
+    {
+      extents_drop ();
+      return;
+    }
+  e->start = start;
+  e->cnt = cnt;
+  extent_link (e);
+}
+
+/* Returns the extent starting at SECTOR, or a null pointer. */
+static struct free_extent *
+extent_find (block_sector_t sector)
+{
+  struct free_extent key;
+  struct avl_elem *e;
+
+  key.start = sector;
+  e = avl_find (&extents_by_start, &key.start_elem);
+  return e != NULL ? avl_entry (e, struct free_extent, start_elem) : NULL;
+}
+
+/* Returns the extent starting before SECTOR with the greatest start,
+   or a null pointer. */
+static struct free_extent *
+extent_find_before (block_sector_t sector)
+{
+  struct free_extent key;
+  struct avl_elem *e;
+
+  key.start = sector;
+  e = avl_lower_bound (&extents_by_start, &key.start_elem);
+  e = e != NULL ? avl_prev (e) : avl_last (&extents_by_start);
+  return e != NULL ? avl_entry (e, struct free_extent, start_elem) : NULL;
+}
+
+/* Returns the extent that holds SECTOR, or a null pointer. */
+static struct free_extent *
+extent_find_around (block_sector_t sector)
+{
+  struct free_extent *e = extent_find (sector);
+
+  if (e == NULL)
+    e = extent_find_before (sector);
+  return e != NULL && extent_end (e) > sector ? e : NULL;
+}
+
+/* Returns the extent ending right before SECTOR, or a null
+   pointer. */
+static struct free_extent *
+extent_find_end (block_sector_t sector)
+{
+  struct free_extent *e = extent_find_before (sector);
+  return e != NULL && extent_end (e) == sector ? e : NULL;
+}
+
+/* Builds the index from the bitmap. */
+static void
+extents_build (void)
+{
+  size_t start = 0, end;
+
+  extents_drop ();
+  extents_valid = true;
+  while (extents_valid
+         && (start = bitmap_scan (free_map, start, 1, false)) != BITMAP_ERROR)
+    {
+      end = bitmap_scan (free_map, start, 1, true);
+      if (end == BITMAP_ERROR)
+        end = bitmap_size (free_map);
+      extent_add (start, end - start);
+      start = end;
+    }
+}
+
+/* Returns the smallest extent of at least CNT sectors, the lowest
+   one of them if several fit equally well, or a null pointer if
+   there is none. */
+static struct free_extent *
+extents_best_fit (size_t cnt)
+{
+  struct free_extent key;
+  struct avl_elem *e;
+
+  key.start = 0;
+  key.cnt = cnt;
+  e = avl_lower_bound (&extents_by_size, &key.size_elem);
+  return e != NULL ? avl_entry (e, struct free_extent, size_elem) : NULL;
+}
+
+/* Removes the CNT free sectors at START from the index.  Must be
+   called before they are marked in the bitmap. */
+static void
+extents_take (block_sector_t start, size_t cnt)
+{
+  struct free_extent *e = extent_find_around (start);
+  size_t right;
+
+  ASSERT (e != NULL && extent_end (e) >= start + cnt);
+
+  right = extent_end (e) - (start + cnt);
+  extent_unlink (e);
+  if (start > e->start)
+    {
+      e->cnt = start - e->start;
+      extent_link (e);
+      if (right > 0)
+        extent_add (start + cnt, right);
+    }
+  else if (right > 0)
+    {
+      e->start = start + cnt;
+      e->cnt = right;
+      extent_link (e);
+    }
+  else
+    free (e);
+}
+
+/* Adds the CNT just released sectors at START to the index, merged
+   with the free extents around them. */
+static void
+extents_give (block_sector_t start, size_t cnt)
+{
+  struct free_extent *prev = extent_find_end (start);
+  struct free_extent *next = extent_find (start + cnt);
+
+  if (prev != NULL)
+    {
+      extent_unlink (prev);
+      prev->cnt += cnt;
+      if (next != NULL)
+        {
+          extent_unlink (next);
+          prev->cnt += next->cnt;
+          free (next);
+        }
+      extent_link (prev);
+    }
+  else if (next != NULL)
+    {
+      extent_unlink (next);
+      next->start = start;
+      next->cnt += cnt;
+      extent_link (next);
+    }
+  else
+    extent_add (start, cnt);
+}
+
+/* Returns the first extent of at least CNT sectors starting after
+   SECTOR, among the next EXTENT_WALK_MAX extents, or a null
+   pointer. */
+static struct free_extent *
+extents_next_fit (block_sector_t sector, size_t cnt)
+{
+  struct free_extent key;
+  struct avl_elem *e;
+  int i;
+
+  key.start = sector;
+  e = avl_upper_bound (&extents_by_start, &key.start_elem);
+  for (i = 0; e != NULL && i < EXTENT_WALK_MAX; e = avl_next (e), i++)
+    {
+      struct free_extent *f = avl_entry (e, struct free_extent, start_elem);
+      if (f->cnt >= cnt)
+        return f;
+    }
+  return NULL;
+}
+
+/* Returns the first of CNT free consecutive sectors close behind
+   GOAL, or BITMAP_ERROR if there are none.  Takes the sectors at GOAL
+   if they are free, otherwise the nearest extent behind GOAL that
+   fits them, and the smallest extent that fits anywhere on the disk
+   if none of the next few does.  Without the index the bitmap is
+   scanned from GOAL on, wrapping around at the end of the disk. */
+static block_sector_t
+free_map_find (block_sector_t goal, size_t cnt)
+{
+  block_sector_t sector;
+
+  if (extents_valid)
+    {
+      struct free_extent *e = extent_find_around (goal);
+      if (e != NULL && extent_end (e) - goal >= cnt)
+        return goal;
+      e = extents_next_fit (goal, cnt);
+      if (e == NULL)
+        e = extents_best_fit (cnt);
+      return e != NULL ? e->start : BITMAP_ERROR;
+    }
+  sector = bitmap_scan (free_map, goal, cnt, false);
+  if (sector == BITMAP_ERROR && goal > 0)
+    sector = bitmap_scan (free_map, 0, cnt, false);
+  return sector;
+}
+
+/* Records that the CNT bits starting at SECTOR of the free map
+   changed. */
+static void
+free_map_mark_changed (block_sector_t sector, size_t cnt)
+{
+  size_t first = sector / BITS_PER_SECTOR;
+  size_t last = (sector + cnt - 1) / BITS_PER_SECTOR;
+  bitmap_set_multiple (free_map_changed, first, last - first + 1, true);
+}
+
+/* Writes the changed sectors of the free map to the free map file.
+   Returns true if successful, false otherwise. */
+static bool
+free_map_write_changed (void)
+{
+  size_t i = 0;
+  bool success = true;
+
+  if (free_map_file == NULL)
+    return true;
+  while ((i = bitmap_scan (free_map_changed, i, 1, true)) != BITMAP_ERROR)
+    {
+      if (bitmap_write_range (free_map, free_map_file,
+                              i * BITS_PER_SECTOR, BITS_PER_SECTOR))
+        bitmap_reset (free_map_changed, i);
+      else
+        success = false;
+      i++;
+    }
+  return success;
 }
 
 /* Allocates CNT consecutive sectors from the free map and stores
-   the first into *SECTORP.
+   the first into *SECTORP.  The sectors are taken at GOAL if they
+   fit there, otherwise as close behind GOAL as possible.
    Returns true if successful, false if not enough consecutive
    sectors were available or if the free_map file could not be
    written. */
 bool
-free_map_allocate (size_t cnt, block_sector_t *sectorp)
+free_map_allocate_near (block_sector_t goal, size_t cnt,
+                        block_sector_t *sectorp)
 {
-  block_sector_t sector = bitmap_scan_and_flip (free_map, 0, cnt, false);
-  if (sector != BITMAP_ERROR
-      && free_map_file != NULL
-      && !bitmap_write (free_map, free_map_file))
+  lock_acquire_re (&free_map_lock);
+  if (goal >= bitmap_size (free_map))
+    goal = 0;
+  block_sector_t sector = free_map_find (goal, cnt);
+  if (sector != BITMAP_ERROR)
     {
-      bitmap_set_multiple (free_map, sector, cnt, false); 
-      sector = BITMAP_ERROR;
+      if (extents_valid)
+        extents_take (sector, cnt);
+      bitmap_set_multiple (free_map, sector, cnt, true);
+      free_map_mark_changed (sector, cnt);
+      if (!free_map_write_changed ())
+        {
+          bitmap_set_multiple (free_map, sector, cnt, false); 
+          if (extents_valid)
+            extents_give (sector, cnt);
+          sector = BITMAP_ERROR;
+        }
     }
   if (sector != BITMAP_ERROR)
     *sectorp = sector;
+  lock_release_re (&free_map_lock);
   log_debug("_F_ Allocate block %d _F_\n", sector);
   return sector != BITMAP_ERROR;
 }
 
+/* Allocates CNT consecutive sectors from the free map and stores
+   the first into *SECTORP.  Searches from behind the previous
+   allocation without a goal instead of from the start of the disk.
+   Returns true if successful, false if not enough consecutive
+   sectors were available or if the free_map file could not be
+   written. */
+bool
+free_map_allocate (size_t cnt, block_sector_t *sectorp)
+{
+  bool success;
+
+  lock_acquire_re (&free_map_lock);
+  success = free_map_allocate_near (free_map_cursor, cnt, sectorp);
+  if (success)
+    free_map_cursor = *sectorp + cnt;
+  lock_release_re (&free_map_lock);
+  return success;
+}
+
+/* Allocates a run of at most CNT consecutive sectors as close behind
+   GOAL as possible and stores the first into *SECTORP.  If no run of
+   CNT sectors is free the request is halved until it fits.  If not
+   even one sector is free but removed files are still waiting for
+   the reclaim thread, waits for it and tries once more, so the
+   caller must not hold free_map_lock.
+   Returns the number of sectors allocated, 0 if the disk is full. */
+size_t
+free_map_allocate_run (block_sector_t goal, size_t cnt,
+                       block_sector_t *sectorp)
+{
+  size_t try;
+
+  for (try = cnt; try > 0; try /= 2)
+    if (free_map_allocate_near (goal, try, sectorp))
+      return try;
+  if (!inode_reclaim_wait ())
+    return 0;
+  for (try = cnt; try > 0; try /= 2)
+    if (free_map_allocate_near (goal, try, sectorp))
+      return try;
+  return 0;
+}
+
+/* Returns the first sector of the block group following the one
+   of SECTOR, wrapping around at the end of the disk. */
+block_sector_t
+free_map_next_group (block_sector_t sector)
+{
+  block_sector_t next = ROUND_DOWN (sector, BLOCK_GROUP_SECTORS)
+                        + BLOCK_GROUP_SECTORS;
+  return next < bitmap_size (free_map) ? next : 0;
+}
+
 /* Makes CNT sectors starting at SECTOR available for use. */
 void
 free_map_release (block_sector_t sector, size_t cnt)
 {
+  lock_acquire_re (&free_map_lock);
   ASSERT (bitmap_all (free_map, sector, cnt));
   bitmap_set_multiple (free_map, sector, cnt, false);
-  bitmap_write (free_map, free_map_file);
+  if (extents_valid)
+    extents_give (sector, cnt);
+  free_map_mark_changed (sector, cnt);
+  if (release_batch_cnt == 0)
+    free_map_write_changed ();
+  lock_release_re (&free_map_lock);
+}
+
+/* Starts a release batch.  Until the matching
+   free_map_release_end(), released sectors are only marked free in
+   memory, so releasing many sectors writes the free map once. */
+void
+free_map_release_begin (void)
+{
+  lock_acquire_re (&free_map_lock);
+  release_batch_cnt++;
+  lock_release_re (&free_map_lock);
+}
+
+/* Ends a release batch started by free_map_release_begin() and
+   writes the free map if it was the last open batch. */
+void
+free_map_release_end (void)
+{
+  lock_acquire_re (&free_map_lock);
+  ASSERT (release_batch_cnt > 0);
+  if (--release_batch_cnt == 0)
+    free_map_write_changed ();
+  lock_release_re (&free_map_lock);
+}
+
+/* Returns the number of additional owners of SECTOR. */
+static uint8_t
+refcount_get (block_sector_t sector)
+{
+  uint8_t cnt = 0;
+  if (refcount_file != NULL)
+    file_read_at (refcount_file, &cnt, sizeof cnt, sector);
+  return cnt;
+}
+
+/* Adds an owner to SECTOR.
+   Returns false if SECTOR has already the maximum number of
+   owners. */
+bool
+free_map_ref (block_sector_t sector)
+{
+  uint8_t cnt;
+  bool success = false;
+
+  lock_acquire_re (&free_map_lock);
+  ASSERT (bitmap_test (free_map, sector));
+  cnt = refcount_get (sector);
+  if (refcount_file != NULL && cnt < UINT8_MAX)
+    {
+      cnt++;
+      success = file_write_at (refcount_file, &cnt, sizeof cnt, sector)
+                == sizeof cnt;
+    }
+  lock_release_re (&free_map_lock);
+  return success;
+}
+
+/* Drops an owner of SECTOR.
+   Returns true if SECTOR is still used by another owner, false if
+   the caller was the only owner and has to release it. */
+bool
+free_map_unref (block_sector_t sector)
+{
+  uint8_t cnt;
+  bool shared;
+
+  lock_acquire_re (&free_map_lock);
+  cnt = refcount_get (sector);
+  shared = cnt > 0;
+  if (shared)
+    {
+      cnt--;
+      file_write_at (refcount_file, &cnt, sizeof cnt, sector);
+    }
+  lock_release_re (&free_map_lock);
+  return shared;
+}
+
+/* Returns true if SECTOR has more than one owner. */
+bool
+free_map_shared (block_sector_t sector)
+{
+  bool shared;
+
+  lock_acquire_re (&free_map_lock);
+  shared = refcount_get (sector) > 0;
+  lock_release_re (&free_map_lock);
+  return shared;
+}
+
+/* Allocates a single sector for file system metadata, inodes and
+   index blocks, close behind GOAL and stores it into *SECTORP.
+
+   The sector is taken from a batch of sectors reserved by the
+   running thread, so concurrent writers only meet on free_map_lock
+   once per RESERVE_SECTORS allocations.  The batch is returned and a
+   new one is reserved when it runs empty or GOAL lies in another
+   block group.
+   Returns true if successful, false if the disk is full. */
+bool
+free_map_allocate_reserved (block_sector_t goal, block_sector_t *sectorp)
+{
+  struct free_map_reservation *r = &thread_current ()->fs_reserve;
+  block_sector_t group = goal / BLOCK_GROUP_SECTORS;
+
+  if (r->cnt == 0 || r->group != group)
+    {
+      free_map_return (r);
+      r->cnt = free_map_allocate_run (goal, RESERVE_SECTORS, &r->start);
+      r->group = group;
+      if (r->cnt == 0)
+        return false;
+    }
+  *sectorp = r->start++;
+  r->cnt--;
+  return true;
+}
+
+/* Releases the sectors left in reservation R. */
+void
+free_map_return (struct free_map_reservation *r)
+{
+  if (r->cnt > 0)
+    free_map_release (r->start, r->cnt);
+  r->cnt = 0;
+}
+
+/* Stores statistics about the free space into *STATS. */
+void
+free_map_stats (struct free_map_stats *stats)
+{
+  struct avl_elem *e;
+
+  lock_acquire_re (&free_map_lock);
+  if (!extents_valid)
+    extents_build ();
+  stats->free_cnt = 0;
+  stats->extent_cnt = avl_size (&extents_by_start);
+  stats->largest_extent = 0;
+  for (e = avl_first (&extents_by_start); e != NULL; e = avl_next (e))
+    stats->free_cnt += avl_entry (e, struct free_extent, start_elem)->cnt;
+  e = avl_last (&extents_by_size);
+  if (e != NULL)
+    stats->largest_extent = avl_entry (e, struct free_extent,
+                                       size_elem)->cnt;
+  lock_release_re (&free_map_lock);
 }
 
 /* Opens the free map file and reads it from disk. */
@@ -61,12 +654,20 @@ free_map_open (void)
     PANIC ("can't open free map");
   if (!bitmap_read (free_map, free_map_file))
     PANIC ("can't read free map");
+  lock_acquire_re (&free_map_lock);
+  extents_build ();
+  lock_release_re (&free_map_lock);
+  refcount_file = file_open (inode_open (REFCOUNT_SECTOR));
+  if (refcount_file == NULL)
+    PANIC ("can't open reference count map");
 }
 
 /* Writes the free map to disk and closes the free map file. */
 void
 free_map_close (void) 
 {
+  file_close (refcount_file);
+  refcount_file = NULL;
   file_close (free_map_file);
 }
 
@@ -85,4 +686,12 @@ free_map_create (void)
     PANIC ("can't open free map");
   if (!bitmap_write (free_map, free_map_file))
     PANIC ("can't write free map");
+
+  /* Create the reference count map, all counts start at zero. */
+  if (!inode_create (REFCOUNT_SECTOR, 0, false))
+    PANIC ("reference count map creation failed");
+  refcount_file = file_open (inode_open (REFCOUNT_SECTOR));
+  if (refcount_file == NULL
+      || !file_allocate (refcount_file, 0, block_size (fs_device)))
+    PANIC ("can't allocate reference count map");
 }
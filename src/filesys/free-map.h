@@ -5,6 +5,24 @@
 #include <stddef.h>
 #include "devices/block.h"
 
+/* Free space statistics, see free_map_stats(). */
+struct free_map_stats
+  {
+    size_t free_cnt;            /* Number of free sectors. */
+    size_t extent_cnt;          /* Number of runs of free sectors. */
+    size_t largest_extent;      /* Length of the longest run. */
+  };
+
+/* Sectors reserved from the free map by one thread, handed out
+   without touching the free map, see free_map_allocate_reserved(). */
+struct free_map_reservation
+  {
+    block_sector_t start;       /* Next reserved sector. */
+    size_t cnt;                 /* Number of reserved sectors left. */
+    block_sector_t group;       /* Block group the sectors were
+                                   reserved for. */
+  };
+
 void free_map_init (void);
 void free_map_read (void);
 void free_map_create (void);
@@ -12,6 +30,18 @@ void free_map_open (void);
 void free_map_close (void);
 
 bool free_map_allocate (size_t, block_sector_t *);
+bool free_map_allocate_near (block_sector_t goal, size_t, block_sector_t *);
+size_t free_map_allocate_run (block_sector_t goal, size_t, block_sector_t *);
+block_sector_t free_map_next_group (block_sector_t);
+void free_map_stats (struct free_map_stats *);
+bool free_map_allocate_reserved (block_sector_t goal, block_sector_t *);
+void free_map_return (struct free_map_reservation *);
 void free_map_release (block_sector_t, size_t);
+void free_map_release_begin (void);
+void free_map_release_end (void);
+
+bool free_map_ref (block_sector_t);
+bool free_map_unref (block_sector_t);
+bool free_map_shared (block_sector_t);
 
 #endif /* filesys/free-map.h */
@@ -1,11 +1,15 @@
 #include "filesys/inode.h"
+#include <hash.h>
 #include <list.h>
 #include <debug.h>
+#include <lz.h>
 #include <round.h>
 #include <string.h>
 #include "filesys/filesys.h"
 #include "filesys/free-map.h"
+#include "filesys/journal.h"
 #include "threads/malloc.h"
+#include "threads/thread.h"
 #include "filesys/cache.h"
 
 /* Identifies an inode. */
@@ -13,147 +17,952 @@
 
 #define NON_EXISTANT 0x0
 
+/* Set in an index entry whose data sector is allocated but was
+   never written.  Such a sector reads as zeros and is only zeroed
+   in the cache once it is written to. */
+#define INODE_UNWRITTEN 0x80000000
+
+/* Set in the index entries of a compressed cluster.
+
+   A file created while compression is enabled stores each cluster
+   of CLUSTER_SECTORS data sectors, aligned in the file, compressed
+   once all of it has been written, if that saves a sector.  The
+   first entries of the cluster then hold the consecutive sectors of
+   the compressed data, the rest hold INODE_COMPRESSED alone.  So the
+   block map records the compressed length in sectors.  A write to
+   the cluster turns it back into plain sectors first. */
+#define INODE_COMPRESSED 0x40000000
+
+/* All flags of an index entry. */
+#define INODE_FLAGS (INODE_UNWRITTEN | INODE_COMPRESSED)
+
+/* Data sectors of a compressed cluster, 4 kB. */
+#define CLUSTER_SECTORS 8
+#define CLUSTER_SIZE ((off_t) (CLUSTER_SECTORS * BLOCK_SECTOR_SIZE))
+
+/* Number of entries in an index block. */
+#define INDEX_CNT (BLOCK_SECTOR_SIZE / sizeof (block_sector_t))
+
+/* Maximal height of the index tree.  Four levels cover files up to
+   the limit of off_t. */
+#define INDEX_MAX_DEPTH 4
+
+/* Removed inodes of at least this length get their sectors freed
+   by the reclaim thread, so that closing them returns quickly. */
+#define RECLAIM_MIN_LENGTH ((off_t) (INDEX_CNT * BLOCK_SECTOR_SIZE))
+
+/* Minimal number of sectors reserved at once for a file that is
+   written sequentially. */
+#define PREALLOC_SECTORS 16
+
+/* Maximal number of closed inodes kept in memory. */
+#define RETAIN_MAX 64
+
 struct lock inode_list_lock;
 
-/* List of open inodes, so that opening a single inode twice
-   returns the same `struct inode'. */
-static struct list open_inodes;
+/* Inodes in memory, keyed by sector, so that opening a single inode
+   twice returns the same `struct inode'.  Besides the open inodes
+   this holds up to RETAIN_MAX closed ones with open_cnt 0, which
+   keep their length and index state, so that reopening them reads
+   nothing from disk.  Both are protected by inode_list_lock. */
+static struct hash open_inodes;
+static struct list retained_inodes;     /* Least recently closed first. */
+static size_t retained_cnt;
 
 /* On-disk inode.
    Must be exactly BLOCK_SECTOR_SIZE bytes long. */
 struct inode_disk
   {
-    /* DO NOT change start length or is_dir without change in inode */
-    block_sector_t start;               /* First data sector. */
+    /* DO NOT change start length is_dir or depth without change in inode */
+    block_sector_t start;               /* Root index block. */
     off_t length;                       /* File size in bytes. */
     bool is_dir;
-    uint8_t unused2[3];
+    uint8_t depth;                      /* Height of the index tree. */
+    bool compressed;                    /* Compress full clusters? */
+    bool shared;                        /* Ever cloned, see inode_clone(). */
     unsigned magic;                     /* Magic number. */
     uint32_t unused[124];               /* Not used. */
 
   };
 
+/* Removed inode whose sectors still have to be freed. */
+struct reclaim_item
+  {
+    struct list_elem elem;              /* Element in reclaim_list. */
+    block_sector_t sector;              /* Sector of the inode. */
+    block_sector_t start;               /* Root index block. */
+    int depth;                          /* Height of the index tree. */
+  };
+
+/* Pending reclaim_items, the front one is being freed.  Changes
+   are broadcast on reclaim_cond. */
+static struct list reclaim_list;
+static struct lock reclaim_lock;
+static struct condition reclaim_cond;
+static bool reclaim_running;
+
+static void inode_free_blocks (block_sector_t sector, block_sector_t start,
+                               int depth);
+static void reclaim_thread (void *aux UNUSED);
+static off_t inode_read (struct inode *, void *, off_t size, off_t offset,
+                         bool direct);
+static off_t inode_write (struct inode *, void *, off_t size, off_t offset,
+                          bool direct);
+
 /* In-memory inode. */
-/* DO NOT change start length or is_dir without change in inode_disk */
+/* DO NOT change start length is_dir or depth without change in inode_disk */
 struct inode 
   {
-    struct list_elem elem;              /* Element in inode list. */
+    struct hash_elem elem;              /* Element in open_inodes. */
+    struct list_elem lru_elem;          /* In retained_inodes if closed. */
     block_sector_t sector;              /* Sector number of disk location. */
-    block_sector_t start; /* DO NOT change start length or is_dir without change in inode_disk */
-    off_t length;/* DO NOT change start length or is_dir without change in inode_disk */
-    bool is_dir;/* DO NOT change start length or is_dir without change in inode_disk */
+    block_sector_t start; /* DO NOT change start length is_dir or depth without change in inode_disk */
+    off_t length;/* DO NOT change start length is_dir or depth without change in inode_disk */
+    bool is_dir;/* DO NOT change start length is_dir or depth without change in inode_disk */
+    uint8_t depth;/* DO NOT change start length is_dir or depth without change in inode_disk */
+    bool compressed;/* DO NOT change start length is_dir or depth without change in inode_disk */
+    bool shared;/* DO NOT change start length is_dir or depth without change in inode_disk */
     int open_cnt;                       /* Number of openers. */
+    bool closing;                       /* Last close not finished. */
     bool removed;                       /* True if deleted, false otherwise. */
     int deny_write_cnt;                 /* 0: writes ok, >0: deny writes. */
+    int list_cnt;                       /* Directory handles listing. */
 
     struct lock lock;
 
+    /* Preallocation window, sectors reserved for the data following
+       the last allocated sector.  Protected by `lock'. */
+    block_sector_t prealloc_start;      /* Next sector of the window. */
+    size_t prealloc_cnt;                /* Sectors left in the window. */
+    off_t prealloc_pos;                 /* File offset of prealloc_start. */
+
+    /* Last leaf index block looked up, accesses close to each other
+       skip the upper levels of the tree.  Protected by `lock'. */
+    size_t leaf_idx;                    /* Data sector index / INDEX_CNT. */
+    block_sector_t leaf_table;          /* NON_EXISTANT if none. */
+
+    /* Last compressed cluster read, decompressed, followed by room
+       for the compressed data.  Protected by `lock'. */
+    uint8_t *cluster_buf;               /* Null if none yet. */
+    size_t cluster_idx;                 /* SIZE_MAX if invalid. */
+
+    /* Byte ranges being written.  Writes to overlapping ranges wait
+       for each other on range_cond, others run concurrently.
+       Protected by range_lock. */
+    struct list write_ranges;
+    struct lock range_lock;
+    struct condition range_cond;
+  };
+
+/* Range of bytes locked by a writer, see struct inode. */
+struct write_range
+  {
+    struct list_elem elem;              /* In write_ranges. */
+    off_t start;                        /* First byte. */
+    off_t end;                          /* One past the last byte. */
   };
 
+/* Upper end of a range that covers the rest of a file. */
+#define RANGE_EOF INT32_MAX
+
+/* Waits until no other writer holds bytes START to END of INODE
+   and then locks them as R, which lives until range_release(). */
+static void
+range_acquire (struct inode *inode, struct write_range *r,
+               off_t start, off_t end)
+{
+  struct list_elem *e;
+
+  lock_acquire_re (&inode->range_lock);
+ retry:
+  for (e = list_begin (&inode->write_ranges);
+       e != list_end (&inode->write_ranges); e = list_next (e))
+    {
+      struct write_range *other = list_entry (e, struct write_range, elem);
+      if (other->start < end && start < other->end)
+        {
+          cond_wait (&inode->range_cond, &inode->range_lock);
+          goto retry;
+        }
+    }
+  r->start = start;
+  r->end = end;
+  list_push_back (&inode->write_ranges, &r->elem);
+  lock_release_re (&inode->range_lock);
+}
+
+/* Unlocks range R of INODE. */
+static void
+range_release (struct inode *inode, struct write_range *r)
+{
+  lock_acquire_re (&inode->range_lock);
+  list_remove (&r->elem);
+  cond_broadcast (&inode->range_cond, &inode->range_lock);
+  lock_release_re (&inode->range_lock);
+}
+
+/* Raises the length of INODE to LENGTH if it is shorter.  Writers
+   of disjoint ranges only meet here. */
+static void
+length_extend (struct inode *inode, off_t length)
+{
+  lock_acquire_re(&inode->lock);
+  if (inode->length < length)
+    inode->length = length;
+  lock_release_re(&inode->lock);
+}
+
+/* Returns true if index entry SECTOR has no data to read. */
+static inline bool
+is_hole (block_sector_t sector)
+{
+  /* Preallocated but never written, reads like a hole */
+  return sector == NON_EXISTANT || (sector & INODE_UNWRITTEN);
+}
+
+/* Number of data sectors below one entry of an index block at
+   HEIGHT.  Leaf index blocks, which point to data sectors, have
+   height 1. */
+static size_t
+index_span (int height)
+{
+  size_t span = 1;
+  while (--height > 0)
+    span *= INDEX_CNT;
+  return span;
+}
+
+/* Returns entry IDX of index block TABLE. */
+static block_sector_t
+index_get (block_sector_t table, size_t idx)
+{
+  block_sector_t sector;
+  in_cache_and_read (table, idx * sizeof sector, &sector, sizeof sector);
+  return sector;
+}
+
+/* Sets entry IDX of index block TABLE to SECTOR. */
+static void
+index_set (block_sector_t table, size_t idx, block_sector_t sector)
+{
+  in_cache_and_overwrite_meta (table, idx * sizeof sector,
+                               &sector, sizeof sector);
+}
+
+/* Converts data sector index IDX into a byte offset, saturating at
+   the largest off_t. */
+static off_t
+idx_to_ofs (size_t idx)
+{
+  if (idx > INT32_MAX / BLOCK_SECTOR_SIZE)
+    return INT32_MAX;
+  return (off_t) idx * BLOCK_SECTOR_SIZE;
+}
+
+/* Puts a new root on top of the index tree of INODE, which must be
+   locked.  The old root becomes the first entry of the new one, so
+   no existing entry moves.  Returns false if the disk is full. */
+static bool
+index_grow (struct inode *inode)
+{
+  block_sector_t root;
+
+  ASSERT (inode->depth < INDEX_MAX_DEPTH);
+  if (!free_map_allocate_reserved (inode->sector, &root))
+    return false;
+  zero_out_sector_meta (root);
+  index_set (root, 0, inode->start);
+  inode->start = root;
+  inode->depth++;
+  in_cache_and_overwrite_meta (inode->sector,
+                               offsetof (struct inode_disk, start),
+                               &inode->start, sizeof inode->start);
+  in_cache_and_overwrite_meta (inode->sector,
+                               offsetof (struct inode_disk, depth),
+                               &inode->depth, sizeof inode->depth);
+  return true;
+}
+
+/* Returns the leaf index block of INODE that holds the entry of
+   data sector IDX.
+
+   If CREATE is true, missing index blocks are allocated and the tree
+   is grown as needed.  Returns NON_EXISTANT if the disk is full.
+   Otherwise returns NON_EXISTANT if an index block on the way is
+   missing and, if HOLE_END is non-null, stores the index of the
+   first data sector after the range it would cover into *HOLE_END. */
+static block_sector_t
+index_lookup_leaf (struct inode *inode, size_t idx, bool create,
+                   size_t *hole_end)
+{
+  block_sector_t table;
+  int height;
+
+  lock_acquire_re(&inode->lock);
+  if (inode->leaf_table != NON_EXISTANT && inode->leaf_idx == idx / INDEX_CNT) {
+    table = inode->leaf_table;
+    lock_release_re(&inode->lock);
+    return table;
+  }
+  while (idx >= index_span (inode->depth + 1)) {
+    /* Beyond the capacity of the tree */
+    if (!create || !index_grow (inode)) {
+      lock_release_re(&inode->lock);
+      if (hole_end != NULL)
+        *hole_end = SIZE_MAX;
+      return NON_EXISTANT;
+    }
+  }
+  table = inode->start;
+  height = inode->depth;
+  lock_release_re(&inode->lock);
+
+  for (; height > 1; height--) {
+    size_t span = index_span (height);
+    size_t i = idx / span % INDEX_CNT;
+    block_sector_t next = index_get (table, i);
+    if (next == NON_EXISTANT) {
+      if (!create) {
+        if (hole_end != NULL)
+          *hole_end = ROUND_DOWN (idx, span) + span;
+        return NON_EXISTANT;
+      }
+      lock_acquire_re(&inode->lock);
+      /* Revalidate still not existant */
+      next = index_get (table, i);
+      if (next == NON_EXISTANT) {
+        if (!free_map_allocate_reserved (inode->sector, &next)) {
+          lock_release_re(&inode->lock);
+          return NON_EXISTANT;
+        }
+        zero_out_sector_meta (next);
+        index_set (table, i, next);
+      }
+      lock_release_re(&inode->lock);
+    }
+    ASSERT(next < block_size(fs_device));
+    table = next;
+  }
+
+  lock_acquire_re(&inode->lock);
+  inode->leaf_idx = idx / INDEX_CNT;
+  inode->leaf_table = table;
+  lock_release_re(&inode->lock);
+  return table;
+}
+
 /* Returns the block device sector that contains byte offset POS
    within INODE.
-   Returns -1 if INODE does not contain data for a byte at offset
-   POS. */
+   Returns NON_EXISTANT if INODE does not contain data for a byte at
+   offset POS.  In that case, if HOLE_END is non-null, stores the
+   offset at which the hole around POS ends into *HOLE_END.  A
+   missing index block makes the whole range it would cover a
+   hole.  A sector of a compressed cluster is returned with
+   INODE_COMPRESSED set, see cluster_read(). */
 static block_sector_t
-byte_to_sector (struct inode *inode, off_t pos)
+byte_to_sector (struct inode *inode, off_t pos, off_t *hole_end)
 {
   log_debug("!!!byte_to_sector, inode->start: %d, pos: %d!!!\n", inode ->start, pos);
-  block_sector_t sector;
+  block_sector_t table, sector;
+  size_t idx = pos / BLOCK_SECTOR_SIZE;
+  size_t hole;
   ASSERT (inode != NULL);
-    in_cache_and_read(inode->start,
-                    (pos/(128*BLOCK_SECTOR_SIZE))*sizeof(block_sector_t),
-                    &sector,
-                    sizeof(sector));
-  ASSERT(sector < block_size(fs_device));
-    if (sector == NON_EXISTANT) return sector;
-  in_cache_and_read(sector,
-                    (pos%(128*BLOCK_SECTOR_SIZE))/BLOCK_SECTOR_SIZE*sizeof(block_sector_t)
-                    ,
-                    &sector,
-                    sizeof(sector));
-    ASSERT(sector < block_size(fs_device));
+
+  table = index_lookup_leaf (inode, idx, false, &hole);
+  if (table == NON_EXISTANT) {
+    if (hole_end != NULL)
+      *hole_end = idx_to_ofs (hole);
+    return NON_EXISTANT;
+  }
+  sector = index_get (table, idx % INDEX_CNT);
+  if (is_hole(sector)) {
+    if (hole_end != NULL) {
+      /* Look for the end of the hole in the same index block */
+      block_sector_t blocks[INDEX_CNT];
+      size_t i = idx % INDEX_CNT;
+      in_cache_and_read(table, 0, blocks, BLOCK_SECTOR_SIZE);
+      while (i < INDEX_CNT && is_hole(blocks[i]))
+        i++;
+      *hole_end = idx_to_ofs (ROUND_DOWN (idx, INDEX_CNT) + i);
+    }
+    return NON_EXISTANT;
+  }
+  ASSERT((sector & ~INODE_COMPRESSED) < block_size(fs_device));
   return sector;
 }
 
+/* Returns the sector behind which data for byte offset POS of INODE
+   should be allocated: the data sector before POS if there is one,
+   otherwise the inode itself. */
+static block_sector_t
+inode_goal (struct inode *inode, off_t pos)
+{
+  if (pos >= BLOCK_SECTOR_SIZE) {
+    block_sector_t prev = byte_to_sector (inode, pos - BLOCK_SECTOR_SIZE,
+                                          NULL);
+    if (prev != NON_EXISTANT && !(prev & INODE_COMPRESSED))
+      return prev + 1;
+  }
+  return inode->sector + 1;
+}
+
+/* Allocates the data sector for byte offset POS of INODE, which
+   must be locked.  CNT is the number of sectors the caller is about
+   to write starting at POS.
+
+   Sectors are handed out of the inode's preallocation window, so
+   that a stream of appends ends up consecutive on disk and the free
+   map is only touched once per window.  If POS does not continue the
+   window, the window is dropped and a new run sized to the write
+   (at least PREALLOC_SECTORS for appends) is reserved. */
+static bool
+inode_alloc_data (struct inode *inode, off_t pos, size_t cnt,
+                  block_sector_t *sectorp)
+{
+  pos = ROUND_DOWN (pos, BLOCK_SECTOR_SIZE);
+  if (inode->prealloc_cnt == 0 || inode->prealloc_pos != pos)
+    {
+      if (inode->prealloc_cnt > 0)
+        free_map_release (inode->prealloc_start, inode->prealloc_cnt);
+      if (pos >= inode->length && cnt < PREALLOC_SECTORS)
+        cnt = PREALLOC_SECTORS;
+      inode->prealloc_cnt = free_map_allocate_run (inode_goal (inode, pos),
+                                                   cnt, &inode->prealloc_start);
+      inode->prealloc_pos = pos;
+      if (inode->prealloc_cnt == 0)
+        return false;
+    }
+
+  *sectorp = inode->prealloc_start++;
+  inode->prealloc_cnt--;
+  inode->prealloc_pos += BLOCK_SECTOR_SIZE;
+  return true;
+}
+
+/* Sectors collected by inode_free_blocks(), consecutive ones are
+   released together. */
+struct release_run
+  {
+    block_sector_t start;
+    size_t cnt;
+  };
+
+static void
+release_run_add (struct release_run *run, block_sector_t sector)
+{
+  if (run->cnt > 0 && run->start + run->cnt == sector) {
+    run->cnt++;
+    return;
+  }
+  if (run->cnt > 0)
+    free_map_release (run->start, run->cnt);
+  run->start = sector;
+  run->cnt = 1;
+}
+
+/* Returns the scratch memory of INODE, which must be locked, for
+   its compressed clusters: the decompressed cluster, room for the
+   compressed data and the work area of lz_compress().
+   Returns a null pointer if memory allocation fails. */
+static uint8_t *
+cluster_buffer (struct inode *inode)
+{
+  if (inode->cluster_buf == NULL)
+    inode->cluster_buf = malloc (2 * CLUSTER_SIZE + LZ_WORK_SIZE);
+  return inode->cluster_buf;
+}
+
+/* Decompresses cluster CLUSTER of INODE, which must be locked, into
+   the cluster buffer, unless it is there already.  The entries of
+   the cluster are in leaf index block TABLE.
+   Returns false if the cluster is not compressed (any more) or if
+   memory allocation fails. */
+static bool
+cluster_load (struct inode *inode, block_sector_t table, size_t cluster)
+{
+  block_sector_t blocks[CLUSTER_SECTORS];
+  uint8_t *buf, *stream;
+  size_t i, len;
+
+  in_cache_and_read (table,
+                     cluster * CLUSTER_SECTORS % INDEX_CNT * sizeof *blocks,
+                     blocks, sizeof blocks);
+  if (!(blocks[0] & INODE_COMPRESSED))
+    return false;
+  if (inode->cluster_idx == cluster)
+    return true;
+  buf = cluster_buffer (inode);
+  if (buf == NULL)
+    return false;
+
+  /* The compressed data is in consecutive sectors */
+  stream = buf + CLUSTER_SIZE;
+  for (i = 0; i < CLUSTER_SECTORS && blocks[i] != INODE_COMPRESSED; i++)
+    in_cache_and_read (blocks[i] & ~INODE_COMPRESSED, 0,
+                       stream + i * BLOCK_SECTOR_SIZE, BLOCK_SECTOR_SIZE);
+  len = lz_decompress (stream, i * BLOCK_SECTOR_SIZE, buf, CLUSTER_SIZE);
+  memset (buf + len, 0, CLUSTER_SIZE - len);
+  inode->cluster_idx = cluster;
+  return true;
+}
+
+/* Copies the LEN bytes of INODE starting at OFFSET, which lie in a
+   compressed cluster, into BUFFER.
+   Returns false if the cluster is not compressed any more, because
+   a writer expanded it meanwhile, or if memory allocation fails. */
+static bool
+cluster_read (struct inode *inode, off_t offset, void *buffer, off_t len)
+{
+  size_t idx = offset / BLOCK_SECTOR_SIZE;
+  block_sector_t table;
+  bool success = false;
+
+  ASSERT (offset % CLUSTER_SIZE + len <= CLUSTER_SIZE);
+  lock_acquire_re(&inode->lock);
+  table = index_lookup_leaf (inode, idx, false, NULL);
+  if (table != NON_EXISTANT
+      && cluster_load (inode, table, idx / CLUSTER_SECTORS)) {
+    memcpy (buffer, inode->cluster_buf + offset % CLUSTER_SIZE, len);
+    success = true;
+  }
+  lock_release_re(&inode->lock);
+  return success;
+}
+
+/* Turns the compressed cluster of INODE, which must be locked, that
+   holds byte offset POS back into plain data sectors.  Its entries
+   are in leaf index block TABLE.  Does nothing if the cluster is
+   not compressed.  Returns false if memory or disk allocation
+   fails. */
+static bool
+cluster_expand (struct inode *inode, block_sector_t table, off_t pos)
+{
+  size_t cluster = pos / CLUSTER_SIZE;
+  size_t slot = cluster * CLUSTER_SECTORS % INDEX_CNT;
+  block_sector_t blocks[CLUSTER_SECTORS], data[CLUSTER_SECTORS];
+  size_t i;
+
+  in_cache_and_read (table, slot * sizeof *blocks, blocks, sizeof blocks);
+  if (!(blocks[0] & INODE_COMPRESSED))
+    return true;
+  if (!cluster_load (inode, table, cluster))
+    return false;
+
+  for (i = 0; i < CLUSTER_SECTORS; i++) {
+    off_t ofs = cluster * CLUSTER_SIZE + i * BLOCK_SECTOR_SIZE;
+    if (!inode_alloc_data (inode, ofs, CLUSTER_SECTORS - i, &data[i])) {
+      while (i-- > 0)
+        free_map_release (data[i], 1);
+      return false;
+    }
+    in_cache_and_overwrite_new (data[i], 0,
+                                inode->cluster_buf + i * BLOCK_SECTOR_SIZE,
+                                BLOCK_SECTOR_SIZE);
+  }
+  in_cache_and_overwrite_meta (table, slot * sizeof *data, data, sizeof data);
+
+  for (i = 0; i < CLUSTER_SECTORS && blocks[i] != INODE_COMPRESSED; i++) {
+    block_sector_t sector = blocks[i] & ~INODE_COMPRESSED;
+    /* Shared with a clone */
+    if (!free_map_unref (sector))
+      free_map_release (sector, 1);
+  }
+  inode->cluster_idx = SIZE_MAX;
+  return true;
+}
+
+/* Compresses cluster CLUSTER of INODE if all of its sectors have
+   been written and the compressed data takes fewer sectors.  The
+   caller must keep writers out of the cluster. */
+static void
+cluster_compress (struct inode *inode, size_t cluster)
+{
+  size_t slot = cluster * CLUSTER_SECTORS % INDEX_CNT;
+  block_sector_t table, start, blocks[CLUSTER_SECTORS];
+  struct release_run run = { NON_EXISTANT, 0 };
+  uint8_t *buf, *stream;
+  size_t i, len, cnt, got;
+
+  lock_acquire_re(&inode->lock);
+  table = index_lookup_leaf (inode, cluster * CLUSTER_SECTORS, false, NULL);
+  if (table == NON_EXISTANT)
+    goto done;
+  in_cache_and_read (table, slot * sizeof *blocks, blocks, sizeof blocks);
+  for (i = 0; i < CLUSTER_SECTORS; i++)
+    if (is_hole (blocks[i]) || (blocks[i] & INODE_COMPRESSED))
+      goto done;
+  buf = cluster_buffer (inode);
+  if (buf == NULL)
+    goto done;
+
+  inode->cluster_idx = SIZE_MAX;
+  for (i = 0; i < CLUSTER_SECTORS; i++)
+    in_cache_and_read (blocks[i], 0, buf + i * BLOCK_SECTOR_SIZE,
+                       BLOCK_SECTOR_SIZE);
+  stream = buf + CLUSTER_SIZE;
+  len = lz_compress (buf, CLUSTER_SIZE, stream,
+                     CLUSTER_SIZE - BLOCK_SECTOR_SIZE, stream + CLUSTER_SIZE);
+  if (len == 0)
+    /* Would not save a sector */
+    goto done;
+  cnt = DIV_ROUND_UP (len, BLOCK_SECTOR_SIZE);
+  memset (stream + len, 0, cnt * BLOCK_SECTOR_SIZE - len);
+
+  got = free_map_allocate_run (blocks[0], cnt, &start);
+  if (got != cnt) {
+    /* Free space too fragmented, keep the cluster plain */
+    if (got > 0)
+      free_map_release (start, got);
+    goto done;
+  }
+  free_map_release_begin ();
+  for (i = 0; i < CLUSTER_SECTORS; i++) {
+    if (!free_map_unref (blocks[i]))
+      release_run_add (&run, blocks[i]);
+    if (i < cnt) {
+      in_cache_and_overwrite_new (start + i, 0,
+                                  stream + i * BLOCK_SECTOR_SIZE,
+                                  BLOCK_SECTOR_SIZE);
+      blocks[i] = (start + i) | INODE_COMPRESSED;
+    } else
+      blocks[i] = INODE_COMPRESSED;
+  }
+  in_cache_and_overwrite_meta (table, slot * sizeof *blocks,
+                               blocks, sizeof blocks);
+  if (run.cnt > 0)
+    free_map_release (run.start, run.cnt);
+  free_map_release_end ();
+  /* The buffer holds the decompressed cluster already */
+  inode->cluster_idx = cluster;
+done:
+  lock_release_re(&inode->lock);
+}
+
+/* Like byte_to_sector() but allocates missing index and data
+   sectors.  CNT is the number of sectors the caller is about to
+   write starting at POS, used to size the allocation.  If WHOLE is
+   true the caller overwrites the whole sector, so a new sector is
+   not zeroed and a shared one not copied.
+   Returns NON_EXISTANT if the disk is full. */
 static block_sector_t
-byte_to_sector_expand (struct inode *inode, off_t pos)
+byte_to_sector_expand (struct inode *inode, off_t pos, size_t cnt,
+                       bool whole)
 {
   log_debug("!!!byte_to_sector_expand!!!\n");
   block_sector_t tmp, sector;
+  size_t idx = pos / BLOCK_SECTOR_SIZE % INDEX_CNT;
   ASSERT (inode != NULL);
 
-  in_cache_and_read(inode->start,
-                    (pos/(128*BLOCK_SECTOR_SIZE))*sizeof(block_sector_t),
-                    &sector,
-                    sizeof(sector));
-  ASSERT(sector < block_size(fs_device));
-  if (sector == NON_EXISTANT) {
-    lock_acquire_re(&inode->lock);
-    /* Revalidate still not existant */
-    in_cache_and_read(inode->start,
-                    (pos/(128*BLOCK_SECTOR_SIZE))*sizeof(block_sector_t),
-                    &sector,
-                    sizeof(sector));
-    /* Already added, no need anymore */
-    if (sector != NON_EXISTANT) {
-      lock_release_re(&inode->lock);
-      goto step2;
-    }
-    if (!free_map_allocate(1, &sector)){
-      lock_release_re(&inode->lock);
-      return NON_EXISTANT;
-    }
+  tmp = index_lookup_leaf (inode, pos / BLOCK_SECTOR_SIZE, true, NULL);
+  if (tmp == NON_EXISTANT)
+    return NON_EXISTANT;
 
-    zero_out_sector_data(sector); //TODO
-    in_cache_and_overwrite_block(inode->start,
-                    (pos/(128*BLOCK_SECTOR_SIZE))*sizeof(block_sector_t),
-                    &sector,
-                    sizeof(sector));
+  sector = index_get (tmp, idx);
+  if (sector & INODE_COMPRESSED) {
+    /* Written in place, so the cluster goes back to plain sectors */
+    bool success;
+    lock_acquire_re(&inode->lock);
+    success = cluster_expand (inode, tmp, pos);
+    sector = index_get (tmp, idx);
     lock_release_re(&inode->lock);
+    if (!success)
+      return NON_EXISTANT;
   }
-
-step2:
-  tmp = sector;
-  in_cache_and_read(tmp,
-                    (pos%(128*BLOCK_SECTOR_SIZE))/BLOCK_SECTOR_SIZE*sizeof(block_sector_t),
-                    &sector,
-                    sizeof(sector));
-  if (sector == NON_EXISTANT) {
+  if (is_hole(sector)) {
     lock_acquire_re(&inode->lock);
     /* Revalidate still not existant */
-    in_cache_and_read(tmp,
-                    (pos%(128*BLOCK_SECTOR_SIZE))/BLOCK_SECTOR_SIZE*sizeof(block_sector_t),
-                    &sector,
-                    sizeof(sector));
+    sector = index_get (tmp, idx);
     /* Already added, no need anymore */
-    if (sector != NON_EXISTANT) {
+    if (!is_hole(sector)) {
       lock_release_re(&inode->lock);
       goto end;
     }
-    if (!free_map_allocate(1,&sector)) {
+    if (sector & INODE_UNWRITTEN) {
+      /* Preallocated, only the zeros are missing */
+      sector &= ~INODE_UNWRITTEN;
+    } else if (!inode_alloc_data(inode, pos, cnt, &sector)) {
       lock_release_re(&inode->lock);
       return NON_EXISTANT;
     }
-    zero_out_sector_data(sector);
-    in_cache_and_overwrite_block(tmp,
-                    (pos%(128*BLOCK_SECTOR_SIZE))/BLOCK_SECTOR_SIZE*sizeof(block_sector_t),
-                    &sector,
-                    sizeof(sector));
+    if (!whole)
+      zero_out_sector_data(sector);
+    index_set (tmp, idx, sector);
     lock_release_re(&inode->lock);
   }
 end:
+  /* Only inodes that took part in a clone can share sectors.  The flag
+     is set under the whole range of the file, so it cannot change
+     while we hold part of it. */
+  if (inode->shared && free_map_shared (sector)) {
+    /* Shared with a clone, copy before writing */
+    uint8_t data[BLOCK_SECTOR_SIZE];
+    block_sector_t copy;
+    lock_acquire_re(&inode->lock);
+    sector = index_get (tmp, idx);
+    if (free_map_shared (sector)) {
+      if (!inode_alloc_data(inode, pos, cnt, &copy)) {
+        lock_release_re(&inode->lock);
+        return NON_EXISTANT;
+      }
+      if (!whole) {
+        in_cache_and_read (sector, 0, data, BLOCK_SECTOR_SIZE);
+        in_cache_and_overwrite_new (copy, 0, data, BLOCK_SECTOR_SIZE);
+      }
+      index_set (tmp, idx, copy);
+      /* The other owners may have dropped it meanwhile */
+      if (!free_map_unref (sector))
+        free_map_release (sector, 1);
+      sector = copy;
+    }
+    lock_release_re(&inode->lock);
+  }
   ASSERT(sector < block_size(fs_device));
   return sector;
 }
 
 
 
+static unsigned
+inode_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  return hash_int (hash_entry (e, struct inode, elem)->sector);
+}
+
+static bool
+inode_less (const struct hash_elem *a, const struct hash_elem *b,
+            void *aux UNUSED)
+{
+  return hash_entry (a, struct inode, elem)->sector
+         < hash_entry (b, struct inode, elem)->sector;
+}
+
+/* Frees up to CNT retained inodes, least recently closed first.
+   Returns the number freed.  inode_list_lock must be held. */
+static size_t
+retained_evict (size_t cnt)
+{
+  size_t i;
+
+  for (i = 0; i < cnt && !list_empty (&retained_inodes); i++)
+    {
+      struct list_elem *e = list_pop_front (&retained_inodes);
+      struct inode *inode = list_entry (e, struct inode, lru_elem);
+      ASSERT (inode->open_cnt == 0 && !inode->closing);
+      hash_delete (&open_inodes, &inode->elem);
+      retained_cnt--;
+      free (inode);
+    }
+  return i;
+}
+
 /* Initializes the inode module. */
 void
 inode_init (void) 
 {
-  list_init (&open_inodes);
+  hash_init (&open_inodes, inode_hash, inode_less, NULL);
+  list_init (&retained_inodes);
+  retained_cnt = 0;
   lock_init(&inode_list_lock);
+
+  list_init (&reclaim_list);
+  lock_init (&reclaim_lock);
+  cond_init (&reclaim_cond);
+  reclaim_running = thread_create ("FS_RECLAIM", PRI_DEFAULT,
+                                   reclaim_thread, NULL) != TID_ERROR;
+}
+
+/* Waits until the reclaim thread has freed the sectors of all
+   removed inodes handed to it.  Returns true if there were any. */
+bool
+inode_reclaim_wait (void)
+{
+  bool pending;
+
+  lock_acquire_re (&reclaim_lock);
+  pending = !list_empty (&reclaim_list);
+  while (!list_empty (&reclaim_list))
+    cond_wait (&reclaim_cond, &reclaim_lock);
+  lock_release_re (&reclaim_lock);
+  return pending;
+}
+
+/* Frees the sectors of removed inodes in the background. */
+static void
+reclaim_thread (void *aux UNUSED)
+{
+  lock_acquire_re (&reclaim_lock);
+  for (;;)
+    {
+      struct reclaim_item *r;
+      while (list_empty (&reclaim_list))
+        cond_wait (&reclaim_cond, &reclaim_lock);
+      r = list_entry (list_front (&reclaim_list), struct reclaim_item, elem);
+
+      lock_release_re (&reclaim_lock);
+      journal_begin ();
+      inode_free_blocks (r->sector, r->start, r->depth);
+      journal_end ();
+      lock_acquire_re (&reclaim_lock);
+
+      list_remove (&r->elem);
+      free (r);
+      cond_broadcast (&reclaim_cond, &reclaim_lock);
+    }
+}
+
+/* Releases index block TABLE at HEIGHT and everything below it. */
+static void
+index_free (block_sector_t table, int height, struct release_run *run)
+{
+  size_t i;
+
+  if (height == 1) {
+    block_sector_t blocks[INDEX_CNT];
+    in_cache_and_read(table, 0, blocks, BLOCK_SECTOR_SIZE);
+    for (i = 0; i < INDEX_CNT; i++) {
+      block_sector_t sector = blocks[i] & ~INODE_FLAGS;
+      if (sector != NON_EXISTANT && !free_map_unref (sector))
+        release_run_add (run, sector);
+    }
+  } else {
+    /* Entry by entry, keeps the stack small */
+    for (i = 0; i < INDEX_CNT; i++) {
+      block_sector_t next = index_get (table, i);
+      if (next != NON_EXISTANT)
+        index_free (next, height - 1, run);
+    }
+  }
+  free_map_release (table, 1);
+}
+
+/* Frees the index tree of DEPTH levels with root START, including
+   all data sectors not shared with a clone.  Consecutive sectors are
+   released as one run and the free map is written once. */
+static void
+index_free_tree (block_sector_t start, int depth)
+{
+  struct release_run run = { NON_EXISTANT, 0 };
+
+  free_map_release_begin ();
+  index_free (start, depth, &run);
+  if (run.cnt > 0)
+    free_map_release (run.start, run.cnt);
+  free_map_release_end ();
+}
+
+/* Frees inode SECTOR and its index tree of DEPTH levels with root
+   START. */
+static void
+inode_free_blocks (block_sector_t sector, block_sector_t start, int depth)
+{
+  free_map_release_begin ();
+  index_free_tree (start, depth);
+  free_map_release (sector, 1);
+  free_map_release_end ();
+}
+
+/* Copies index block TABLE at HEIGHT and everything below it into
+   new index blocks and stores the copy of TABLE into *COPYP, or
+   NON_EXISTANT if it could not be allocated.  Data sectors are not
+   copied but gain an owner.  Preallocated sectors are left out, they
+   read as zeros either way.  The new index blocks are allocated
+   behind GOAL.
+   Returns false if the copy is incomplete. */
+static bool
+index_clone (block_sector_t table, int height, block_sector_t goal,
+             block_sector_t *copyp)
+{
+  size_t i;
+
+  if (!free_map_allocate_reserved (goal, copyp)) {
+    *copyp = NON_EXISTANT;
+    return false;
+  }
+
+  if (height == 1) {
+    block_sector_t blocks[INDEX_CNT];
+    bool success = true;
+    in_cache_and_read(table, 0, blocks, BLOCK_SECTOR_SIZE);
+    for (i = 0; i < INDEX_CNT; i++) {
+      block_sector_t sector = blocks[i] & ~INODE_COMPRESSED;
+      if (is_hole (blocks[i]) || !success)
+        blocks[i] = NON_EXISTANT;
+      else if (sector != NON_EXISTANT && !free_map_ref (sector)) {
+        /* Too many owners, leave the rest out */
+        blocks[i] = NON_EXISTANT;
+        success = false;
+      }
+    }
+    in_cache_and_overwrite_new_meta (*copyp, 0, blocks, BLOCK_SECTOR_SIZE);
+    return success;
+  }
+
+  zero_out_sector_meta (*copyp);
+  /* Entry by entry, keeps the stack small */
+  for (i = 0; i < INDEX_CNT; i++) {
+    block_sector_t next = index_get (table, i), copy;
+    bool success;
+    if (next == NON_EXISTANT)
+      continue;
+    success = index_clone (next, height - 1, goal, &copy);
+    if (copy != NON_EXISTANT)
+      index_set (*copyp, i, copy);
+    if (!success)
+      return false;
+  }
+  return true;
+}
+
+/* Makes DST, which must be empty, a copy of SRC which shares all data
+   sectors with it.  Only the index blocks are copied, a shared data
+   sector is copied by the first write to it through either inode.
+   Returns false if SRC is a directory or the disk is full. */
+bool
+inode_clone (struct inode *dst, struct inode *src)
+{
+  struct write_range src_range, dst_range;
+  block_sector_t root;
+  bool success = false;
+
+  ASSERT (dst != src);
+  /* No write may be half done, its sectors would be torn between the
+     copy and the original */
+  range_acquire (src, &src_range, 0, RANGE_EOF);
+  range_acquire (dst, &dst_range, 0, RANGE_EOF);
+  lock_acquire_re(&src->lock);
+  if (src->is_dir)
+    goto done;
+  if (!src->shared) {
+    src->shared = true;
+    in_cache_and_overwrite_meta(src->sector,
+                    offsetof(struct inode_disk,shared), &src->shared,
+                    sizeof src->shared);
+  }
+  success = index_clone (src->start, src->depth, dst->sector, &root);
+  if (!success) {
+    if (root != NON_EXISTANT)
+      index_free_tree (root, src->depth);
+    goto done;
+  }
+
+  lock_acquire_re(&dst->lock);
+  ASSERT (dst->length == 0 && !dst->is_dir);
+  index_free_tree (dst->start, dst->depth);
+  dst->start = root;
+  dst->depth = src->depth;
+  dst->length = src->length;
+  dst->shared = true;
+  dst->leaf_table = NON_EXISTANT;
+  in_cache_and_overwrite_meta(dst->sector,
+                  offsetof(struct inode_disk,start),
+                  ((void*)dst) + offsetof(struct inode,start),
+                  offsetof(struct inode_disk,magic) - offsetof(struct inode_disk,start));
+  lock_release_re(&dst->lock);
+done:
+  lock_release_re(&src->lock);
+  range_release (dst, &dst_range);
+  range_release (src, &src_range);
+  return success;
 }
 
 /* Initializes an inode with LENGTH bytes of data and
@@ -180,11 +989,16 @@ inode_create (block_sector_t sector, off_t length, bool is_dir)
       disk_inode->length = length;
       disk_inode->magic = INODE_MAGIC;
       disk_inode->is_dir = is_dir;
-      if (free_map_allocate (1, &disk_inode->start))
+      disk_inode->compressed = filesys_compress && !is_dir
+                               && sector != FREE_MAP_SECTOR
+                               && sector != REFCOUNT_SECTOR;
+      /* Grows on demand, see index_grow() */
+      disk_inode->depth = 1;
+      if (free_map_allocate_reserved (sector, &disk_inode->start))
         {
-          in_cache_and_overwrite_block (sector, 0, disk_inode, sizeof(*disk_inode));
+          in_cache_and_overwrite_meta (sector, 0, disk_inode, sizeof(*disk_inode));
 
-          zero_out_sector_data(disk_inode->start);
+          zero_out_sector_meta(disk_inode->start);
 
           if (sector == FREE_MAP_SECTOR) {
               // special case for handling the free map
@@ -197,24 +1011,18 @@ inode_create (block_sector_t sector, off_t length, bool is_dir)
               // By allocating the file completely in front, this should be avoidable
 
 
-              // assume at most 128 blocks are needed for the free map
-              block_sector_t indirect_blk, data_start, tmp;
-              ASSERT(free_map_allocate(1, &indirect_blk));
-
-              // link indirect in start block
-              in_cache_and_overwrite_block(disk_inode->start,
-                                           0, // first indirect block
-                                           &indirect_blk,
-                                           sizeof(indirect_blk));
-              // get blocks for raw file data
+              // assume at most 128 blocks are needed for the free map,
+              // they fit into the root which is a leaf index block
+              block_sector_t data_start, tmp;
               size_t blocks_needed = DIV_ROUND_UP(length, BLOCK_SECTOR_SIZE);
+              ASSERT(blocks_needed <= INDEX_CNT);
+              // get blocks for raw file data
               ASSERT(free_map_allocate(blocks_needed, &data_start));
-              zero_out_sector_data(indirect_blk);
               int i;
               for (i = 0; i < blocks_needed; i++) {
                   tmp = data_start + i;
               
-                  in_cache_and_overwrite_block(indirect_blk,
+                  in_cache_and_overwrite_meta(disk_inode->start,
                                                i * sizeof(tmp),
                                                &tmp,
                                                sizeof(tmp));
@@ -236,43 +1044,58 @@ struct inode *
 inode_open (block_sector_t sector)
 {
   log_debug("!!!inode_open (sector %d)!!!\n", sector);
-  struct list_elem *e;
+  struct inode key;
+  struct hash_elem *e;
   struct inode *inode;
 
   lock_acquire_re(&inode_list_lock);
-  /* Check whether this inode is already open. */
-  for (e = list_begin (&open_inodes); e != list_end (&open_inodes);
-       e = list_next (e)) 
+  /* Check whether this inode is already open or retained. */
+  key.sector = sector;
+  e = hash_find (&open_inodes, &key.elem);
+  if (e != NULL)
     {
-      inode = list_entry (e, struct inode, elem);
-      if (inode->sector == sector) 
+      inode = hash_entry (e, struct inode, elem);
+      if (inode->open_cnt == 0 && !inode->closing)
         {
-          inode_reopen (inode);
-          lock_release_re(&inode_list_lock);
-          return inode; 
+          list_remove (&inode->lru_elem);
+          retained_cnt--;
         }
+      inode_reopen (inode);
+      lock_release_re(&inode_list_lock);
+      return inode;
     }
 
-  /* Allocate memory. */
+  /* Allocate memory, giving up retained inodes if there is none. */
   inode = malloc (sizeof *inode);
+  while (inode == NULL && retained_evict (RETAIN_MAX / 4) > 0)
+    inode = malloc (sizeof *inode);
   if (inode == NULL) {
     lock_release_re(&inode_list_lock);
     return NULL;
   }
   /* Initialize. */
 
-  list_push_front (&open_inodes, &inode->elem);
   lock_init(&(inode->lock));
   inode->sector = sector;
+  hash_insert (&open_inodes, &inode->elem);
   inode->open_cnt = 1;
+  inode->closing = false;
   inode->deny_write_cnt = 0;
+  inode->list_cnt = 0;
   inode->removed = false;
+  inode->prealloc_cnt = 0;
+  inode->leaf_table = NON_EXISTANT;
+  inode->cluster_buf = NULL;
+  inode->cluster_idx = SIZE_MAX;
+  list_init (&inode->write_ranges);
+  lock_init (&inode->range_lock);
+  cond_init (&inode->range_cond);
   lock_release_re(&inode_list_lock);
 
   in_cache_and_read(inode->sector,
                     offsetof(struct inode_disk,start),
                     ((void*)inode) + offsetof(struct inode,start),
-                    offsetof(struct inode_disk,unused2) - offsetof(struct inode_disk,start));
+                    offsetof(struct inode_disk,magic) - offsetof(struct inode_disk,start));
   return inode;
 }
 
@@ -324,8 +1147,10 @@ inode_isdir (struct inode *inode)
 }
 
 /* Closes INODE and writes it to disk.
-   If this was the last reference to INODE, frees its memory.
-   If INODE was also a removed inode, frees its blocks. */
+   If this was the last reference to INODE, it is retained in memory
+   for a later inode_open(), and the least recently closed inode is
+   freed instead if too many are retained.
+   If INODE was also a removed inode, frees its memory and blocks. */
 void
 inode_close (struct inode *inode) 
 {
@@ -335,38 +1160,70 @@ inode_close (struct inode *inode)
     return;
 
   lock_acquire_re(&inode->lock);
-  /* Release_Re resources if this was the last opener. */
-  if (--inode->open_cnt == 0)
+  if (--inode->open_cnt > 0 || inode->closing) {
+    /* Still open, or revived and closed again while an earlier last
+       close was waiting for inode_list_lock, which finishes it. */
+    lock_release_re(&inode->lock);
+    return;
+  }
+  inode->closing = true;
+  lock_release_re(&inode->lock);
+
+  /* inode_open() takes inode_list_lock first, then the inode lock. */
+  lock_acquire_re(&inode_list_lock);
+  lock_acquire_re(&inode->lock);
+  inode->closing = false;
+  if (inode->open_cnt > 0) {
+    /* Revived in the meantime */
+    lock_release_re(&inode->lock);
+    lock_release_re(&inode_list_lock);
+    return;
+  }
+
+  /* Release_Re resources of the last opener. */
+  log_debug("Close inode %d.\n", inode->sector);
+  /* Return unused preallocated sectors. */
+  if (inode->prealloc_cnt > 0)
+    free_map_release (inode->prealloc_start, inode->prealloc_cnt);
+  inode->prealloc_cnt = 0;
+  free (inode->cluster_buf);
+  inode->cluster_buf = NULL;
+  inode->cluster_idx = SIZE_MAX;
+
+  if (!inode->removed)
     {
-      log_debug("Close inode %d.\n", inode->sector);
-      lock_acquire_re(&inode_list_lock);
-      /* Remove from inode list and release_re lock. */
-      list_remove (&inode->elem);
+      list_push_back (&retained_inodes, &inode->lru_elem);
+      if (++retained_cnt > RETAIN_MAX)
+        retained_evict (retained_cnt - RETAIN_MAX);
+      lock_release_re(&inode->lock);
       lock_release_re(&inode_list_lock);
-      /* Deallocate blocks if removed. */
-      if (inode->removed)
-        {
-          log_debug("Remove inode %d after close.\n", inode->sector);
-          block_sector_t start[128];
-          in_cache_and_read(inode->start, 0, &start, BLOCK_SECTOR_SIZE);
-          int i,j;
-          for (i=0; i<128;i++) {
-            block_sector_t blocks[128];
-            if (start[i]== NON_EXISTANT) continue;
-            in_cache_and_read(start[i], 0, &blocks, BLOCK_SECTOR_SIZE);
-            for (j=0; j<128; j++) {
-              if (blocks[j]== NON_EXISTANT) continue;
-              free_map_release(blocks[j], 1);
-            }
-            free_map_release(start[i],1);
-          }
-          free_map_release(inode->start,1);
-          free_map_release(inode->sector, 1);
-        }
-      free (inode);
       return;
     }
-  lock_release_re(&inode->lock);
+
+  /* Remove from inode table and release_re lock. */
+  hash_delete (&open_inodes, &inode->elem);
+  lock_release_re(&inode_list_lock);
+
+  /* Deallocate blocks. */
+  log_debug("Remove inode %d after close.\n", inode->sector);
+  struct reclaim_item *r = NULL;
+  if (reclaim_running && inode->length >= RECLAIM_MIN_LENGTH)
+    r = malloc (sizeof *r);
+  if (r != NULL) {
+    /* Large file, let the reclaim thread do the work */
+    r->sector = inode->sector;
+    r->start = inode->start;
+    r->depth = inode->depth;
+    lock_acquire_re (&reclaim_lock);
+    list_push_back (&reclaim_list, &r->elem);
+    cond_broadcast (&reclaim_cond, &reclaim_lock);
+    lock_release_re (&reclaim_lock);
+  } else {
+    journal_begin ();
+    inode_free_blocks (inode->sector, inode->start, inode->depth);
+    journal_end ();
+  }
+  free (inode);
 }
 
 /* Marks INODE to be deleted when it is closed by the last caller who
@@ -386,6 +1243,24 @@ inode_remove (struct inode *inode)
    than SIZE if an error occurs or end of file is reached. */
 off_t
 inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset) 
+{
+  return inode_read (inode, buffer_, size, offset, false);
+}
+
+/* Like inode_read_at(), but whole sectors are read from the disk
+   straight into BUFFER, without being brought into the cache.  A
+   cached copy is used if there is one. */
+off_t
+inode_read_at_direct (struct inode *inode, void *buffer_, off_t size,
+                      off_t offset)
+{
+  return inode_read (inode, buffer_, size, offset, true);
+}
+
+/* Reads for inode_read_at() and inode_read_at_direct(). */
+static off_t
+inode_read (struct inode *inode, void *buffer_, off_t size, off_t offset,
+            bool direct)
 {
   log_debug("!!!inode_read_at!!!\n");
   uint8_t *buffer = buffer_;
@@ -394,13 +1269,19 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
   while (size > 0)
     {
       /* Disk sector to read, starting byte offset within sector. */
-      block_sector_t sector_idx = byte_to_sector (inode, offset);
+      off_t hole_end;
+      block_sector_t sector_idx = byte_to_sector (inode, offset, &hole_end);
       int sector_ofs = offset % BLOCK_SECTOR_SIZE;
 
-      /* Bytes left in inode, bytes left in sector, lesser of the two. */
+      /* Bytes left in inode, bytes left in sector, lesser of the two.
+         A hole is zeroed up to its end in one step. */
       off_t inode_left = inode_length (inode) - offset;
-      int sector_left = BLOCK_SECTOR_SIZE - sector_ofs;
-      int min_left = inode_left < sector_left ? inode_left : sector_left;
+      off_t sector_left = sector_idx == NON_EXISTANT
+                          ? hole_end - offset
+                          : sector_idx & INODE_COMPRESSED
+                          ? CLUSTER_SIZE - offset % CLUSTER_SIZE
+                          : BLOCK_SECTOR_SIZE - sector_ofs;
+      off_t min_left = inode_left < sector_left ? inode_left : sector_left;
 
       /* Number of bytes to actually copy out of this sector. */
       int chunk_size = size < min_left ? size : min_left;
@@ -410,6 +1291,16 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
       if (sector_idx == NON_EXISTANT) {
         memset(buffer + bytes_read, 0, chunk_size);
       }
+      else if (sector_idx & INODE_COMPRESSED) {
+        if (!cluster_read (inode, offset, buffer + bytes_read, chunk_size)) {
+          if (byte_to_sector (inode, offset, NULL) & INODE_COMPRESSED)
+            break;      /* Out of memory */
+          continue;     /* Expanded by a writer, look again */
+        }
+      }
+      else if (direct && chunk_size == BLOCK_SECTOR_SIZE) {
+        cache_read_direct (sector_idx, buffer + bytes_read);
+      }
       else {
           /* Read full sector directly into caller's buffer. */
       in_cache_and_read (sector_idx,
@@ -428,6 +1319,38 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
   return bytes_read;
 }
 
+/* Returns the offset of the first byte at or after OFFSET that
+   lies in a hole of INODE if HOLE is true, or that has data if HOLE
+   is false.  The end of the file counts as a hole.
+   Returns -1 if OFFSET is at or beyond the end of the file or if
+   there is no more data after OFFSET. */
+off_t
+inode_seek_data (struct inode *inode, off_t offset, bool hole)
+{
+  off_t length = inode_length (inode);
+  off_t pos = offset;
+
+  while (pos < length)
+    {
+      off_t hole_end;
+      if (byte_to_sector (inode, pos, &hole_end) == NON_EXISTANT)
+        {
+          if (hole)
+            return pos;
+          pos = hole_end;
+        }
+      else
+        {
+          if (!hole)
+            return pos;
+          pos = ROUND_DOWN (pos, BLOCK_SECTOR_SIZE) + BLOCK_SECTOR_SIZE;
+        }
+    }
+  if (hole && offset < length)
+    return length;
+  return -1;
+}
+
 /* Writes SIZE bytes from BUFFER into INODE, starting at OFFSET.
    Returns the number of bytes actually written, which may be
    less than SIZE if end of file is reached or an error occurs.
@@ -436,11 +1359,33 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
 off_t
 inode_write_at (struct inode *inode, void *buffer_, off_t size,
                 off_t offset) 
+{
+  return inode_write (inode, buffer_, size, offset, false);
+}
+
+/* Like inode_write_at(), but whole sectors are written from BUFFER
+   straight to the disk, without being brought into the cache.  A
+   cached copy is updated. */
+off_t
+inode_write_at_direct (struct inode *inode, void *buffer_, off_t size,
+                       off_t offset)
+{
+  return inode_write (inode, buffer_, size, offset, true);
+}
+
+/* Writes for inode_write_at() and inode_write_at_direct(). */
+static off_t
+inode_write (struct inode *inode, void *buffer_, off_t size, off_t offset,
+             bool direct)
 {
   log_debug("!!!inode_write_at (inode %d, size %d, offset %d)!!!\n", inode->sector, size, offset);
   uint8_t *buffer = buffer_;
   off_t bytes_written = 0;
   off_t o_offset = offset;
+  struct write_range range;
+  /* Directories and the maps of the free map module are metadata */
+  bool meta = inode->is_dir || inode->sector == FREE_MAP_SECTOR
+              || inode->sector == REFCOUNT_SECTOR;
 
   lock_acquire_re(&inode->lock);
   if (inode->deny_write_cnt) {
@@ -449,12 +1394,22 @@ inode_write_at (struct inode *inode, void *buffer_, off_t size,
   }
   lock_release_re(&inode->lock);
 
+  journal_begin ();
+  /* Only writers of overlapping bytes exclude each other, allocation
+     of sectors is serialized by the inode lock. */
+  range_acquire (inode, &range, offset, offset + size);
+
   while (size > 0)
     {
       /* Sector to write, starting byte offset within sector. */
-      block_sector_t sector_idx = byte_to_sector_expand (inode, offset);
-      if (sector_idx == NON_EXISTANT) break;
       int sector_ofs = offset % BLOCK_SECTOR_SIZE;
+      size_t sectors_left = DIV_ROUND_UP (sector_ofs + size, BLOCK_SECTOR_SIZE);
+      /* Metadata always goes through the cache and the journal */
+      bool whole = direct && !meta && sector_ofs == 0
+                   && size >= BLOCK_SECTOR_SIZE;
+      block_sector_t sector_idx = byte_to_sector_expand (inode, offset,
+                                                         sectors_left, whole);
+      if (sector_idx == NON_EXISTANT) break;
 
       /* Bytes left in inode, bytes left in sector, lesser of the two. */
 
@@ -465,10 +1420,16 @@ inode_write_at (struct inode *inode, void *buffer_, off_t size,
       if (chunk_size <= 0)
         break;
 
-      in_cache_and_overwrite_block (sector_idx,
-                                    sector_ofs,
-                                    buffer + bytes_written,
-                                    chunk_size);
+      if (whole)
+        cache_write_direct (sector_idx, buffer + bytes_written);
+      else if (meta)
+        in_cache_and_overwrite_meta (sector_idx, sector_ofs,
+                                     buffer + bytes_written, chunk_size);
+      else
+        in_cache_and_overwrite_block (sector_idx,
+                                      sector_ofs,
+                                      buffer + bytes_written,
+                                      chunk_size);
 
       /* Advance. */
       size -= chunk_size;
@@ -476,12 +1437,339 @@ inode_write_at (struct inode *inode, void *buffer_, off_t size,
       bytes_written += chunk_size;
     }
 
+  length_extend (inode, o_offset + bytes_written);
+  range_release (inode, &range);
+
+  /* Compress the clusters whose last byte was just written */
+  if (inode->compressed) {
+    size_t cluster;
+    for (cluster = o_offset / CLUSTER_SIZE;
+         cluster < (size_t) (o_offset + bytes_written) / CLUSTER_SIZE;
+         cluster++) {
+      range_acquire (inode, &range, cluster * CLUSTER_SIZE,
+                     (cluster + 1) * CLUSTER_SIZE);
+      cluster_compress (inode, cluster);
+      range_release (inode, &range);
+    }
+  }
+  journal_end ();
+
+  return bytes_written;
+}
+
+/* Reserves disk space for the SIZE bytes of INODE starting at
+   OFFSET and extends INODE to cover them, like a write of zeros
+   would.
+
+   All missing sectors of the range are allocated in as few
+   consecutive runs as possible and each index block is written
+   once.  The data sectors are marked INODE_UNWRITTEN instead of
+   being zeroed, later writes to them need no allocation.
+   Returns false if writes are denied or the disk is full.  Sectors allocated before
+   the disk filled up stay with INODE. */
+bool
+inode_allocate (struct inode *inode, off_t offset, off_t size)
+{
+  log_debug("!!!inode_allocate (inode %d, size %d, offset %d)!!!\n", inode->sector, size, offset);
+  ASSERT (offset >= 0 && size >= 0);
+  size_t first = offset / BLOCK_SECTOR_SIZE;
+  size_t end = DIV_ROUND_UP (offset + size, BLOCK_SECTOR_SIZE);
+  size_t missing = 0;
+  size_t idx;
+  block_sector_t run_start = NON_EXISTANT;
+  size_t run_cnt = 0;
+  bool success = true;
+
+  journal_begin ();
   lock_acquire_re(&inode->lock);
-  inode->length = inode->length > o_offset + bytes_written ?
-                  inode->length : o_offset + bytes_written ;
+  if (inode->deny_write_cnt) {
+    lock_release_re(&inode->lock);
+    journal_end ();
+    return false;
+  }
+
+  /* Count missing sectors so they can be reserved as one run. */
+  for (idx = first; idx < end; )
+    {
+      block_sector_t table, blocks[INDEX_CNT];
+      size_t hole, last = ROUND_DOWN (idx, INDEX_CNT) + INDEX_CNT;
+      table = index_lookup_leaf (inode, idx, false, &hole);
+      if (table == NON_EXISTANT) {
+        last = hole < end ? hole : end;
+        missing += last - idx;
+        idx = last;
+        continue;
+      }
+      if (last > end)
+        last = end;
+      in_cache_and_read(table, 0, blocks, BLOCK_SECTOR_SIZE);
+      for (; idx < last; idx++)
+        if (blocks[idx % INDEX_CNT] == NON_EXISTANT)
+          missing++;
+    }
+
+  /* Fill in the leaf index blocks. */
+  for (idx = first; idx < end && success; )
+    {
+      block_sector_t table, blocks[INDEX_CNT];
+      size_t last = ROUND_DOWN (idx, INDEX_CNT) + INDEX_CNT;
+      if (last > end)
+        last = end;
+
+      table = index_lookup_leaf (inode, idx, true, NULL);
+      if (table == NON_EXISTANT) {
+        success = false;
+        break;
+      }
+
+      in_cache_and_read(table, 0, blocks, BLOCK_SECTOR_SIZE);
+      for (; idx < last; idx++) {
+        if (blocks[idx % INDEX_CNT] != NON_EXISTANT)
+          continue;
+        if (run_cnt == 0) {
+          run_cnt = free_map_allocate_run(inode_goal (inode, idx_to_ofs (idx)),
+                                          missing, &run_start);
+          if (run_cnt == 0) {
+            success = false;
+            break;
+          }
+        }
+        blocks[idx % INDEX_CNT] = run_start++ | INODE_UNWRITTEN;
+        run_cnt--;
+        missing--;
+      }
+      in_cache_and_overwrite_meta(table, 0, blocks, BLOCK_SECTOR_SIZE);
+    }
+  if (run_cnt > 0)
+    free_map_release(run_start, run_cnt);
+
+  if (success)
+    length_extend (inode, offset + size);
   lock_release_re(&inode->lock);
+  journal_end ();
+  return success;
+}
 
-  return bytes_written;
+/* Shrinks INODE to LENGTH bytes and frees the data sectors past the
+   new end.  Index blocks stay until INODE is removed.  Does nothing
+   if INODE is not longer than LENGTH. */
+void
+inode_truncate (struct inode *inode, off_t length)
+{
+  struct release_run run = { NON_EXISTANT, 0 };
+  struct write_range range;
+  size_t idx, end;
+
+  ASSERT (length >= 0);
+  /* No writer may be in the sectors about to be freed */
+  range_acquire (inode, &range, length, RANGE_EOF);
+  journal_begin ();
+  lock_acquire_re(&inode->lock);
+  if (length >= inode->length) {
+    lock_release_re(&inode->lock);
+    journal_end ();
+    range_release (inode, &range);
+    return;
+  }
+  if (inode->prealloc_cnt > 0) {
+    free_map_release (inode->prealloc_start, inode->prealloc_cnt);
+    inode->prealloc_cnt = 0;
+  }
+
+  idx = DIV_ROUND_UP (length, BLOCK_SECTOR_SIZE);
+  end = DIV_ROUND_UP (inode->length, BLOCK_SECTOR_SIZE);
+  if (length % CLUSTER_SIZE != 0
+      && (byte_to_sector (inode, length, NULL) & INODE_COMPRESSED)) {
+    /* Cut inside a compressed cluster, its data must stay readable */
+    block_sector_t table = index_lookup_leaf (inode, length / BLOCK_SECTOR_SIZE,
+                                              false, NULL);
+    if (!cluster_expand (inode, table, length))
+      idx = ROUND_UP (idx, CLUSTER_SECTORS);
+  }
+  inode->cluster_idx = SIZE_MAX;
+
+  free_map_release_begin ();
+  while (idx < end)
+    {
+      block_sector_t table, blocks[INDEX_CNT];
+      size_t hole, last = ROUND_DOWN (idx, INDEX_CNT) + INDEX_CNT;
+      table = index_lookup_leaf (inode, idx, false, &hole);
+      if (table == NON_EXISTANT) {
+        idx = hole;
+        continue;
+      }
+      if (last > end)
+        last = end;
+      in_cache_and_read(table, 0, blocks, BLOCK_SECTOR_SIZE);
+      for (; idx < last; idx++) {
+        block_sector_t sector = blocks[idx % INDEX_CNT] & ~INODE_FLAGS;
+        if (sector != NON_EXISTANT && !free_map_unref (sector))
+          release_run_add (&run, sector);
+        blocks[idx % INDEX_CNT] = NON_EXISTANT;
+      }
+      in_cache_and_overwrite_meta(table, 0, blocks, BLOCK_SECTOR_SIZE);
+    }
+  if (run.cnt > 0)
+    free_map_release (run.start, run.cnt);
+  free_map_release_end ();
+
+  inode->length = length;
+  lock_release_re(&inode->lock);
+  journal_end ();
+  range_release (inode, &range);
+}
+
+/* Returns the number of extents, runs of consecutive sectors, the
+   data of INODE is stored in and stores the number of its data
+   sectors into *SECTORS.  INODE must be locked. */
+static size_t
+inode_extents (struct inode *inode, size_t *sectors)
+{
+  size_t idx = 0, end = DIV_ROUND_UP (inode->length, BLOCK_SECTOR_SIZE);
+  size_t extents = 0;
+  block_sector_t next = NON_EXISTANT;
+
+  *sectors = 0;
+  while (idx < end)
+    {
+      block_sector_t table, blocks[INDEX_CNT];
+      size_t hole, last = ROUND_DOWN (idx, INDEX_CNT) + INDEX_CNT;
+      table = index_lookup_leaf (inode, idx, false, &hole);
+      if (table == NON_EXISTANT) {
+        idx = hole;
+        continue;
+      }
+      if (last > end)
+        last = end;
+      in_cache_and_read(table, 0, blocks, BLOCK_SECTOR_SIZE);
+      for (; idx < last; idx++) {
+        block_sector_t sector = blocks[idx % INDEX_CNT] & ~INODE_FLAGS;
+        if (sector == NON_EXISTANT)
+          continue;
+        if (sector != next)
+          extents++;
+        next = sector + 1;
+        ++*sectors;
+      }
+    }
+  return extents;
+}
+
+/* Moves the data sectors below leaf index block TABLE,
+   entries FIRST to LAST, into one run of consecutive sectors behind
+   *GOAL, unless they form one already.  Compressed clusters and
+   sectors shared with a clone stay where they are, SHARED tells
+   whether the inode may have any.  Updates *GOAL
+   to the sector behind the moved ones.  BUF is room for one sector.
+   The inode must be locked. */
+static void
+index_defrag_leaf (block_sector_t table, size_t first, size_t last,
+                   bool shared, block_sector_t *goal, void *buf)
+{
+  block_sector_t blocks[INDEX_CNT], start, prev = NON_EXISTANT;
+  struct release_run run = { NON_EXISTANT, 0 };
+  size_t i, cnt = 0, got;
+  bool contiguous = true;
+
+  in_cache_and_read(table, 0, blocks, BLOCK_SECTOR_SIZE);
+  for (i = first; i < last; i++) {
+    block_sector_t sector = blocks[i] & ~INODE_UNWRITTEN;
+    if (blocks[i] == NON_EXISTANT || (blocks[i] & INODE_COMPRESSED)
+        || (shared && free_map_shared (sector)))
+      continue;
+    if (cnt > 0 && sector != prev + 1)
+      contiguous = false;
+    prev = sector;
+    cnt++;
+  }
+  if (cnt == 0)
+    return;
+  if (contiguous) {
+    *goal = prev + 1;
+    return;
+  }
+
+  got = free_map_allocate_run (*goal, cnt, &start);
+  if (got != cnt) {
+    /* Free space too fragmented, moving only part would not help */
+    if (got > 0)
+      free_map_release (start, got);
+    return;
+  }
+  *goal = start + cnt;
+
+  /* Copy straight to disk, the new sectors must hold the data before
+     the journal commits the index block that points to them */
+  for (i = first; i < last; i++) {
+    block_sector_t sector = blocks[i] & ~INODE_UNWRITTEN;
+    if (blocks[i] == NON_EXISTANT || (blocks[i] & INODE_COMPRESSED)
+        || (shared && free_map_shared (sector)))
+      continue;
+    if (!(blocks[i] & INODE_UNWRITTEN)) {
+      cache_read_direct (sector, buf);
+      cache_write_direct (start, buf);
+    }
+    blocks[i] = start++ | (blocks[i] & INODE_UNWRITTEN);
+    release_run_add (&run, sector);
+  }
+  in_cache_and_overwrite_meta(table, 0, blocks, BLOCK_SECTOR_SIZE);
+  if (run.cnt > 0)
+    free_map_release (run.start, run.cnt);
+}
+
+/* Moves the data sectors of INODE into as few runs of consecutive
+   sectors as possible, close to the inode.  Each leaf index block is
+   rewritten at once, after the data has been copied, so readers see
+   either the old or the new sectors.  Stores the number of extents
+   before and after into *BEFORE and *AFTER and returns the number of
+   data sectors.  Returns 0 with *BEFORE and *AFTER unchanged if
+   memory allocation fails. */
+size_t
+inode_defrag (struct inode *inode, size_t *before, size_t *after)
+{
+  struct write_range range;
+  block_sector_t goal;
+  size_t idx = 0, end, sectors;
+  void *buf = malloc (BLOCK_SECTOR_SIZE);
+
+  if (buf == NULL)
+    return 0;
+  range_acquire (inode, &range, 0, RANGE_EOF);
+  journal_begin ();
+  lock_acquire_re(&inode->lock);
+  *before = inode_extents (inode, &sectors);
+
+  /* The preallocation window may hold the space wanted */
+  if (inode->prealloc_cnt > 0) {
+    free_map_release (inode->prealloc_start, inode->prealloc_cnt);
+    inode->prealloc_cnt = 0;
+  }
+  free_map_release_begin ();
+  goal = inode->sector + 1;
+  end = DIV_ROUND_UP (inode->length, BLOCK_SECTOR_SIZE);
+  while (idx < end)
+    {
+      size_t hole, last = ROUND_DOWN (idx, INDEX_CNT) + INDEX_CNT;
+      block_sector_t table = index_lookup_leaf (inode, idx, false, &hole);
+      if (table == NON_EXISTANT) {
+        idx = hole;
+        continue;
+      }
+      if (last > end)
+        last = end;
+      index_defrag_leaf (table, idx % INDEX_CNT,
+                         last - ROUND_DOWN (idx, INDEX_CNT), inode->shared,
+                         &goal, buf);
+      idx = last;
+    }
+  free_map_release_end ();
+
+  *after = inode_extents (inode, &sectors);
+  lock_release_re(&inode->lock);
+  journal_end ();
+  range_release (inode, &range);
+  free (buf);
+  return sectors;
 }
 
 /* Disables writes to INODE.
@@ -510,6 +1798,39 @@ inode_allow_write (struct inode *inode)
   lock_release_re(&inode->lock);
 }
 
+/* Marks a directory handle of INODE as being in the middle of a
+   listing, see dir_readdir(). */
+void
+inode_list_begin (struct inode *inode)
+{
+  lock_acquire_re(&inode->lock);
+  inode->list_cnt++;
+  ASSERT (inode->list_cnt <= inode->open_cnt);
+  lock_release_re(&inode->lock);
+}
+
+/* Ends a listing started with inode_list_begin().
+   Returns true if no other listing of INODE is in progress. */
+bool
+inode_list_end (struct inode *inode)
+{
+  lock_acquire_re(&inode->lock);
+  ASSERT (inode->list_cnt > 0);
+  bool tmp = --inode->list_cnt == 0;
+  lock_release_re(&inode->lock);
+  return tmp;
+}
+
+/* Returns true if a listing of INODE is in progress. */
+bool
+inode_listed (struct inode *inode)
+{
+  lock_acquire_re(&inode->lock);
+  bool tmp = inode->list_cnt > 0;
+  lock_release_re(&inode->lock);
+  return tmp;
+}
+
 /* Returns the length, in bytes, of INODE's data. */
 off_t
 inode_length (struct inode *inode)
@@ -8,6 +8,7 @@
 struct bitmap;
 
 void inode_init (void);
+bool inode_reclaim_wait (void);
 bool inode_create (block_sector_t, off_t, bool);
 struct inode *inode_open (block_sector_t);
 struct inode *inode_reopen (struct inode *);
@@ -18,8 +19,19 @@ void inode_close (struct inode *);
 void inode_remove (struct inode *);
 off_t inode_read_at (struct inode *, void *, off_t size, off_t offset);
 off_t inode_write_at (struct inode *, void *, off_t size, off_t offset);
+off_t inode_read_at_direct (struct inode *, void *, off_t size, off_t offset);
+off_t inode_write_at_direct (struct inode *, void *, off_t size,
+                             off_t offset);
+bool inode_allocate (struct inode *, off_t offset, off_t size);
+size_t inode_defrag (struct inode *, size_t *before, size_t *after);
+void inode_truncate (struct inode *, off_t length);
+off_t inode_seek_data (struct inode *, off_t offset, bool hole);
+bool inode_clone (struct inode *dst, struct inode *src);
 void inode_deny_write (struct inode *);
 void inode_allow_write (struct inode *);
+void inode_list_begin (struct inode *);
+bool inode_list_end (struct inode *);
+bool inode_listed (struct inode *);
 off_t inode_length (struct inode *);
 void inode_acquire(struct inode * );
 void inode_release(struct inode * );
@@ -0,0 +1,251 @@
+#include "filesys/journal.h"
+#include <debug.h>
+#include <hash.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "devices/timer.h"
+#include "filesys/cache.h"
+#include "filesys/filesys.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+/* Write-ahead journal of file system metadata.
+
+   Changes to metadata sectors (inodes, index blocks, directories,
+   the free map and the reference count map) are marked in the cache
+   and may not be written in place until they have been committed.
+   A commit writes the new contents of all marked sectors, from any
+   number of operations, to the journal region in one sequential run
+   followed by the header, which is the commit record.  Then the
+   sectors are written in place and the header is cleared.  After a
+   crash, a valid header means the in-place writes may be incomplete
+   and they are redone when the file system is mounted.
+
+   Operations that change metadata are enclosed in journal_begin()
+   and journal_end().  Commits are due every JOURNAL_INTERVAL ticks
+   and once JOURNAL_PRESSURE sectors wait, and happen when no
+   operation is running, so each commit holds whole operations.
+   Nothing ever waits for a commit.  Only if the waiting sectors fill
+   half of the cache before operations pause does the cache commit
+   on its own, see get_and_pin_block(). */
+
+/* Identifies a journal header. */
+#define JOURNAL_MAGIC 0x4c4e524a
+
+/* Commit every so many timer ticks. */
+#define JOURNAL_INTERVAL (5 * TIMER_FREQ)
+
+/* Commit as soon as possible once this many sectors wait for a
+   commit, so they leave room in the cache. */
+#define JOURNAL_PRESSURE (JOURNAL_BLOCKS / 4)
+
+/* On-disk journal header in sector JOURNAL_SECTOR.
+   Must be exactly BLOCK_SECTOR_SIZE bytes long. */
+struct journal_header
+  {
+    unsigned magic;                     /* JOURNAL_MAGIC. */
+    uint32_t seq;                       /* Number of the commit. */
+    uint32_t cnt;                       /* Sectors logged, 0 if none. */
+    uint32_t checksum;                  /* Of the logged contents. */
+    block_sector_t sectors[124];        /* Home of each logged sector. */
+  };
+
+static struct lock journal_lock;
+static int journal_active;              /* Operations running. */
+static bool journal_wanted;             /* Commit once none runs. */
+static uint32_t journal_seq;            /* Number of the next commit. */
+
+static void journal_thread (void *aux UNUSED);
+
+/* Returns the checksum of the CNT logged sectors in DATA. */
+static uint32_t
+journal_checksum (void *const *data, size_t cnt)
+{
+  uint32_t checksum = 0;
+  size_t i;
+
+  for (i = 0; i < cnt; i++)
+    checksum = checksum * 31 + hash_bytes (data[i], BLOCK_SECTOR_SIZE);
+  return checksum;
+}
+
+/* Redoes the in-place writes of the commit described by H, if its
+   logged sectors are intact.  Returns the number of sectors
+   written. */
+static size_t
+journal_replay (const struct journal_header *h)
+{
+  void *data[JOURNAL_BLOCKS];
+  size_t i, cnt = 0;
+
+  if (h->magic != JOURNAL_MAGIC || h->cnt == 0 || h->cnt > JOURNAL_BLOCKS)
+    return 0;
+  for (i = 0; i < h->cnt; i++)
+    {
+      data[i] = malloc (BLOCK_SECTOR_SIZE);
+      if (data[i] == NULL)
+        PANIC ("out of memory replaying the journal");
+      block_read (fs_device, JOURNAL_SECTOR + 1 + i, data[i]);
+    }
+  /* Torn commit, the sectors were not touched in place yet */
+  if (journal_checksum (data, h->cnt) == h->checksum)
+    for (cnt = 0; cnt < h->cnt; cnt++)
+      block_write (fs_device, h->sectors[cnt], data[cnt]);
+  for (i = 0; i < h->cnt; i++)
+    free (data[i]);
+  return cnt;
+}
+
+/* Reads the journal header and redoes the commit it describes if
+   REPLAY is true.  Then marks the journal empty, numbering the next
+   commit after the last one.  Returns the number of sectors
+   written in place, 0 if there was no intact commit. */
+static size_t
+journal_load (bool replay)
+{
+  struct journal_header *h;
+  size_t cnt = 0;
+
+  h = malloc (sizeof *h);
+  if (h == NULL)
+    PANIC ("out of memory reading the journal");
+  block_read (fs_device, JOURNAL_SECTOR, h);
+  if (replay)
+    cnt = journal_replay (h);
+  journal_seq = h->magic == JOURNAL_MAGIC ? h->seq + 1 : 0;
+  free (h);
+  journal_clear ();
+  return cnt;
+}
+
+/* Initializes the journal.  Unless FORMAT is true, redoes the last
+   commit if the system stopped before it was written in place.
+   Must be called before any metadata is read. */
+void
+journal_init (bool format)
+{
+  struct journal_header *h;
+  size_t cnt;
+
+  ASSERT (sizeof *h == BLOCK_SECTOR_SIZE);
+  ASSERT (JOURNAL_BLOCKS <= sizeof h->sectors / sizeof *h->sectors);
+  lock_init (&journal_lock);
+
+  cnt = journal_load (!format);
+  if (cnt > 0)
+    printf ("Journal: replayed %zu sectors of commit %u.\n",
+            cnt, (unsigned) journal_seq - 1);
+
+  thread_create ("FS_JOURNAL", PRI_DEFAULT, journal_thread, NULL);
+}
+
+/* Redoes the last commit written to the journal, as mounting does
+   after a crash, and marks the journal empty.  Returns the number
+   of sectors written in place.  No commit may be running, so the
+   caller must be inside journal_begin() and journal_end(). */
+size_t
+journal_recover (void)
+{
+  return journal_load (true);
+}
+
+/* Writes the new contents DATA of the CNT metadata sectors SECTORS
+   to the journal, and then the header that commits them. */
+void
+journal_write (const block_sector_t *sectors, void *const *data, size_t cnt)
+{
+  struct journal_header *h;
+  size_t i;
+
+  ASSERT (cnt <= JOURNAL_BLOCKS);
+  h = calloc (1, sizeof *h);
+  if (h == NULL)
+    PANIC ("out of memory writing the journal");
+  for (i = 0; i < cnt; i++)
+    block_write (fs_device, JOURNAL_SECTOR + 1 + i, data[i]);
+  h->magic = JOURNAL_MAGIC;
+  h->seq = journal_seq++;
+  h->cnt = cnt;
+  h->checksum = journal_checksum (data, cnt);
+  memcpy (h->sectors, sectors, cnt * sizeof *sectors);
+  block_write (fs_device, JOURNAL_SECTOR, h);
+  free (h);
+}
+
+/* Marks the journal empty, once the last commit is written in
+   place. */
+void
+journal_clear (void)
+{
+  struct journal_header *h = calloc (1, sizeof *h);
+  if (h == NULL)
+    PANIC ("out of memory writing the journal");
+  h->magic = JOURNAL_MAGIC;
+  h->seq = journal_seq;
+  block_write (fs_device, JOURNAL_SECTOR, h);
+  free (h);
+}
+
+/* Starts an operation that changes metadata.  Calls nest, only
+   the outermost one counts. */
+void
+journal_begin (void)
+{
+  struct thread *t = thread_current ();
+
+  if (t->journal_depth++ > 0)
+    return;
+  lock_acquire_re (&journal_lock);
+  journal_active++;
+  lock_release_re (&journal_lock);
+}
+
+/* Ends an operation started by journal_begin().  The last running
+   operation to end commits if a commit is due. */
+void
+journal_end (void)
+{
+  struct thread *t = thread_current ();
+
+  ASSERT (t->journal_depth > 0);
+  if (--t->journal_depth > 0)
+    return;
+  lock_acquire_re (&journal_lock);
+  if (--journal_active == 0
+      && (journal_wanted || cache_journal_cnt () >= JOURNAL_PRESSURE))
+    {
+      journal_wanted = false;
+      cache_commit ();
+    }
+  lock_release_re (&journal_lock);
+}
+
+/* Commits the metadata changed by all operations ended so far, right
+   away if none is running, otherwise when the last one ends.  Never
+   waits, so it may be called with any lock held. */
+void
+journal_commit (void)
+{
+  lock_acquire_re (&journal_lock);
+  if (journal_active == 0)
+    {
+      journal_wanted = false;
+      cache_commit ();
+    }
+  else
+    journal_wanted = true;
+  lock_release_re (&journal_lock);
+}
+
+/* Commits every JOURNAL_INTERVAL ticks. */
+static void
+journal_thread (void *aux UNUSED)
+{
+  for (;;)
+    {
+      timer_sleep (JOURNAL_INTERVAL);
+      journal_commit ();
+    }
+}
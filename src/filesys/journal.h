@@ -0,0 +1,25 @@
+#ifndef FILESYS_JOURNAL_H
+#define FILESYS_JOURNAL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "devices/block.h"
+
+/* Most sectors logged by one commit, at least the number of cache
+   entries. */
+#define JOURNAL_BLOCKS 64
+
+/* Sectors of the journal region, a header followed by the logged
+   sectors, starting at JOURNAL_SECTOR. */
+#define JOURNAL_SECTORS (1 + JOURNAL_BLOCKS)
+
+void journal_init (bool format);
+void journal_begin (void);
+void journal_end (void);
+void journal_commit (void);
+void journal_write (const block_sector_t *sectors, void *const *data,
+                    size_t cnt);
+void journal_clear (void);
+size_t journal_recover (void);
+
+#endif /* filesys/journal.h */
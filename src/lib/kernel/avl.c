@@ -0,0 +1,307 @@
+#include "avl.h"
+#include "../debug.h"
+
+static int height (const struct avl_elem *);
+static void update (struct avl_elem *);
+static void replace_child (struct avl *, struct avl_elem *parent,
+                           struct avl_elem *old, struct avl_elem *new);
+static struct avl_elem *rotate_left (struct avl *, struct avl_elem *);
+static struct avl_elem *rotate_right (struct avl *, struct avl_elem *);
+static void rebalance (struct avl *, struct avl_elem *);
+static struct avl_elem *leftmost (struct avl_elem *);
+static struct avl_elem *rightmost (struct avl_elem *);
+
+/* Initializes tree T to compare elements using LESS given
+   auxiliary data AUX. */
+void
+avl_init (struct avl *t, avl_less_func *less, void *aux)
+{
+  ASSERT (t != NULL);
+  ASSERT (less != NULL);
+
+  t->root = NULL;
+  t->elem_cnt = 0;
+  t->less = less;
+  t->aux = aux;
+}
+
+/* Inserts NEW into tree T and returns a null pointer, if no equal
+   element is already in the tree.
+   If an equal element is already in the tree, returns it without
+   inserting NEW. */
+struct avl_elem *
+avl_insert (struct avl *t, struct avl_elem *new)
+{
+  struct avl_elem **link = &t->root, *parent = NULL;
+
+  while (*link != NULL)
+    {
+      parent = *link;
+      if (t->less (new, parent, t->aux))
+        link = &parent->left;
+      else if (t->less (parent, new, t->aux))
+        link = &parent->right;
+      else
+        return parent;
+    }
+
+  new->parent = parent;
+  new->left = new->right = NULL;
+  new->height = 1;
+  *link = new;
+  t->elem_cnt++;
+  rebalance (t, parent);
+  return NULL;
+}
+
+/* Removes E, which must be in tree T, from T. */
+void
+avl_remove (struct avl *t, struct avl_elem *e)
+{
+  struct avl_elem *fix;
+
+  ASSERT (t->elem_cnt > 0);
+
+  if (e->left != NULL && e->right != NULL)
+    {
+      /* Put the next element, which has no left child, into E's
+         place */
+      struct avl_elem *s = leftmost (e->right);
+      if (s->parent == e)
+        fix = s;
+      else
+        {
+          fix = s->parent;
+          fix->left = s->right;
+          if (s->right != NULL)
+            s->right->parent = fix;
+          s->right = e->right;
+          s->right->parent = s;
+        }
+      s->left = e->left;
+      s->left->parent = s;
+      s->height = e->height;
+      replace_child (t, e->parent, e, s);
+    }
+  else
+    {
+      fix = e->parent;
+      replace_child (t, fix, e, e->left != NULL ? e->left : e->right);
+    }
+  t->elem_cnt--;
+  rebalance (t, fix);
+}
+
+/* Finds and returns an element equal to KEY in tree T, or a null
+   pointer if no equal element exists in the tree. */
+struct avl_elem *
+avl_find (const struct avl *t, const struct avl_elem *key)
+{
+  struct avl_elem *e = avl_lower_bound (t, key);
+  return e != NULL && !t->less (key, e, t->aux) ? e : NULL;
+}
+
+/* Returns the first element of tree T that is not less than KEY,
+   or a null pointer if there is none. */
+struct avl_elem *
+avl_lower_bound (const struct avl *t, const struct avl_elem *key)
+{
+  struct avl_elem *e = t->root, *found = NULL;
+
+  while (e != NULL)
+    if (t->less (e, key, t->aux))
+      e = e->right;
+    else
+      {
+        found = e;
+        e = e->left;
+      }
+  return found;
+}
+
+/* Returns the first element of tree T that is greater than KEY,
+   or a null pointer if there is none. */
+struct avl_elem *
+avl_upper_bound (const struct avl *t, const struct avl_elem *key)
+{
+  struct avl_elem *e = t->root, *found = NULL;
+
+  while (e != NULL)
+    if (t->less (key, e, t->aux))
+      {
+        found = e;
+        e = e->left;
+      }
+    else
+      e = e->right;
+  return found;
+}
+
+/* Returns the smallest element of tree T, or a null pointer if T
+   is empty. */
+struct avl_elem *
+avl_first (const struct avl *t)
+{
+  return t->root != NULL ? leftmost (t->root) : NULL;
+}
+
+/* Returns the greatest element of tree T, or a null pointer if T
+   is empty. */
+struct avl_elem *
+avl_last (const struct avl *t)
+{
+  return t->root != NULL ? rightmost (t->root) : NULL;
+}
+
+/* Returns the element after E in its tree, or a null pointer if E
+   is the greatest element. */
+struct avl_elem *
+avl_next (struct avl_elem *e)
+{
+  struct avl_elem *p;
+
+  if (e->right != NULL)
+    return leftmost (e->right);
+  for (p = e->parent; p != NULL && e == p->right; p = p->parent)
+    e = p;
+  return p;
+}
+
+/* Returns the element before E in its tree, or a null pointer if E
+   is the smallest element. */
+struct avl_elem *
+avl_prev (struct avl_elem *e)
+{
+  struct avl_elem *p;
+
+  if (e->left != NULL)
+    return rightmost (e->left);
+  for (p = e->parent; p != NULL && e == p->left; p = p->parent)
+    e = p;
+  return p;
+}
+
+/* Returns the number of elements in T. */
+size_t
+avl_size (const struct avl *t)
+{
+  return t->elem_cnt;
+}
+
+/* Returns true if T contains no elements, false otherwise. */
+bool
+avl_empty (const struct avl *t)
+{
+  return t->elem_cnt == 0;
+}
+
+/* Returns the height of the subtree rooted at E, which may be a
+   null pointer. */
+static int
+height (const struct avl_elem *e)
+{
+  return e != NULL ? e->height : 0;
+}
+
+/* Recomputes the height of E from its children. */
+static void
+update (struct avl_elem *e)
+{
+  int l = height (e->left), r = height (e->right);
+  e->height = (l > r ? l : r) + 1;
+}
+
+/* Makes NEW, which may be a null pointer, take the place of OLD as
+   the child of PARENT, or as the root of T if PARENT is null. */
+static void
+replace_child (struct avl *t, struct avl_elem *parent,
+               struct avl_elem *old, struct avl_elem *new)
+{
+  if (parent == NULL)
+    t->root = new;
+  else if (parent->left == old)
+    parent->left = new;
+  else
+    parent->right = new;
+  if (new != NULL)
+    new->parent = parent;
+}
+
+/* Rotates the subtree rooted at E to the left and returns its new
+   root. */
+static struct avl_elem *
+rotate_left (struct avl *t, struct avl_elem *e)
+{
+  struct avl_elem *r = e->right;
+
+  e->right = r->left;
+  if (r->left != NULL)
+    r->left->parent = e;
+  replace_child (t, e->parent, e, r);
+  r->left = e;
+  e->parent = r;
+  update (e);
+  update (r);
+  return r;
+}
+
+/* Rotates the subtree rooted at E to the right and returns its new
+   root. */
+static struct avl_elem *
+rotate_right (struct avl *t, struct avl_elem *e)
+{
+  struct avl_elem *l = e->left;
+
+  e->left = l->right;
+  if (l->right != NULL)
+    l->right->parent = e;
+  replace_child (t, e->parent, e, l);
+  l->right = e;
+  e->parent = l;
+  update (e);
+  update (l);
+  return l;
+}
+
+/* Restores the balance of the subtrees from E up to the root of T
+   after an insertion or removal below E. */
+static void
+rebalance (struct avl *t, struct avl_elem *e)
+{
+  for (; e != NULL; e = e->parent)
+    {
+      int balance = height (e->left) - height (e->right);
+      if (balance > 1)
+        {
+          if (height (e->left->left) < height (e->left->right))
+            rotate_left (t, e->left);
+          e = rotate_right (t, e);
+        }
+      else if (balance < -1)
+        {
+          if (height (e->right->right) < height (e->right->left))
+            rotate_right (t, e->right);
+          e = rotate_left (t, e);
+        }
+      else
+        update (e);
+    }
+}
+
+/* Returns the smallest element in the subtree rooted at E. */
+static struct avl_elem *
+leftmost (struct avl_elem *e)
+{
+  while (e->left != NULL)
+    e = e->left;
+  return e;
+}
+
+/* Returns the greatest element in the subtree rooted at E. */
+static struct avl_elem *
+rightmost (struct avl_elem *e)
+{
+  while (e->right != NULL)
+    e = e->right;
+  return e;
+}
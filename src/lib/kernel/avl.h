@@ -0,0 +1,82 @@
+#ifndef __LIB_KERNEL_AVL_H
+#define __LIB_KERNEL_AVL_H
+
+/* Balanced binary search tree.
+
+   This is an AVL tree: the heights of the two subtrees of any
+   element differ by at most one, so lookups, insertions and
+   removals take O(log n) time.  Unlike a hash table it keeps its
+   elements in order, so it can also find the first element not
+   less than a key and step to neighbouring elements.
+
+   Like lists and hash tables the tree does not use dynamic
+   allocation.  Each structure that can be in a tree embeds a
+   struct avl_elem member, and the avl_entry macro converts a
+   struct avl_elem back to the structure that contains it.  Refer
+   to lib/kernel/list.h for a detailed explanation.
+
+   Iteration runs from avl_first() with avl_next() until a null
+   pointer is returned.  The tree must not be modified while
+   iterating, except for removing the current element after
+   stepping past it. */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Tree element. */
+struct avl_elem
+  {
+    struct avl_elem *parent;    /* Parent, null for the root. */
+    struct avl_elem *left;      /* Smaller elements. */
+    struct avl_elem *right;     /* Greater elements. */
+    int height;                 /* Height of the subtree, 1 for a leaf. */
+  };
+
+/* Converts pointer to tree element AVL_ELEM into a pointer to the
+   structure that AVL_ELEM is embedded inside.  Supply the name of
+   the outer structure STRUCT and the member name MEMBER of the
+   tree element. */
+#define avl_entry(AVL_ELEM, STRUCT, MEMBER)                     \
+        ((STRUCT *) ((uint8_t *) &(AVL_ELEM)->parent            \
+                     - offsetof (STRUCT, MEMBER.parent)))
+
+/* Compares the value of two tree elements A and B, given
+   auxiliary data AUX.  Returns true if A is less than B, or
+   false if A is greater than or equal to B. */
+typedef bool avl_less_func (const struct avl_elem *a,
+                            const struct avl_elem *b,
+                            void *aux);
+
+/* Tree. */
+struct avl
+  {
+    struct avl_elem *root;      /* Root element, null if empty. */
+    size_t elem_cnt;            /* Number of elements in the tree. */
+    avl_less_func *less;        /* Comparison function. */
+    void *aux;                  /* Auxiliary data for `less'. */
+  };
+
+/* Basic life cycle. */
+void avl_init (struct avl *, avl_less_func *, void *aux);
+
+/* Search, insertion, deletion. */
+struct avl_elem *avl_insert (struct avl *, struct avl_elem *);
+void avl_remove (struct avl *, struct avl_elem *);
+struct avl_elem *avl_find (const struct avl *, const struct avl_elem *);
+struct avl_elem *avl_lower_bound (const struct avl *,
+                                  const struct avl_elem *);
+struct avl_elem *avl_upper_bound (const struct avl *,
+                                  const struct avl_elem *);
+
+/* Traversal. */
+struct avl_elem *avl_first (const struct avl *);
+struct avl_elem *avl_last (const struct avl *);
+struct avl_elem *avl_next (struct avl_elem *);
+struct avl_elem *avl_prev (struct avl_elem *);
+
+/* Information. */
+size_t avl_size (const struct avl *);
+bool avl_empty (const struct avl *);
+
+#endif /* lib/kernel/avl.h */
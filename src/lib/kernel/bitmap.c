@@ -69,6 +69,60 @@ last_mask (const struct bitmap *b)
   return last_bits ? ((elem_type) 1 << last_bits) - 1 : (elem_type) -1;
 }
 
+/* Returns a mask of the bits in an element from bit OFS, counted
+   within the element, up to bit OFS + CNT, exclusive. */
+static inline elem_type
+range_mask (size_t ofs, size_t cnt)
+{
+  elem_type mask = cnt < ELEM_BITS ? ((elem_type) 1 << cnt) - 1 : (elem_type) -1;
+  return mask << ofs;
+}
+
+/* Returns the number of bits set in E.  The masks repeat 01, 0011,
+   00001111 and 00000001 over the whole element, whatever its width. */
+static inline size_t
+elem_popcount (elem_type e)
+{
+  const elem_type ones = (elem_type) -1;
+  e = e - ((e >> 1) & (ones / 3));
+  e = (e & (ones / 5)) + ((e >> 2) & (ones / 5));
+  e = (e + (e >> 4)) & (ones / 17);
+  e *= ones / 255;
+  return e >> (ELEM_BITS - CHAR_BIT);
+}
+
+/* Returns the element of B at IDX, inverted if VALUE is false, so
+   that bits equal to VALUE are set. */
+static inline elem_type
+elem_match (const struct bitmap *b, size_t idx, bool value)
+{
+  return value ? b->bits[idx] : ~b->bits[idx];
+}
+
+/* Returns the index of the first bit in B at or after START that
+   is set to VALUE, or the size of B if there is none.  Skips whole
+   elements that do not match and finds the bit within the first one
+   that does with bsf. */
+static size_t
+find_bit (const struct bitmap *b, size_t start, bool value)
+{
+  size_t idx = elem_idx (start);
+  size_t last = elem_cnt (b->bit_cnt);
+  elem_type e;
+
+  if (start >= b->bit_cnt)
+    return b->bit_cnt;
+  e = elem_match (b, idx, value) & ~(bit_mask (start) - 1);
+  while (e == 0)
+    {
+      if (++idx == last)
+        return b->bit_cnt;
+      e = elem_match (b, idx, value);
+    }
+  start = idx * ELEM_BITS + __builtin_ctzl (e);
+  return start < b->bit_cnt ? start : b->bit_cnt;
+}
+
 /* Creation and destruction. */
 
 /* Creates and returns a pointer to a newly allocated bitmap with room for
@@ -213,18 +267,30 @@ bitmap_set_all (struct bitmap *b, bool value)
   bitmap_set_multiple (b, 0, bitmap_size (b), value);
 }
 
-/* Sets the CNT bits starting at START in B to VALUE. */
+/* Sets the CNT bits starting at START in B to VALUE.
+   Each element is updated atomically. */
 void
 bitmap_set_multiple (struct bitmap *b, size_t start, size_t cnt, bool value) 
 {
-  size_t i;
-  
   ASSERT (b != NULL);
   ASSERT (start <= b->bit_cnt);
   ASSERT (start + cnt <= b->bit_cnt);
 
-  for (i = 0; i < cnt; i++)
-    bitmap_set (b, start + i, value);
+  while (cnt > 0)
+    {
+      size_t idx = elem_idx (start);
+      size_t ofs = start % ELEM_BITS;
+      size_t n = ELEM_BITS - ofs < cnt ? ELEM_BITS - ofs : cnt;
+      elem_type mask = range_mask (ofs, n);
+
+      /* Same as in bitmap_mark() and bitmap_reset(). */
+      if (value)
+        asm ("orl %1, %0" : "=m" (b->bits[idx]) : "r" (mask) : "cc");
+      else
+        asm ("andl %1, %0" : "=m" (b->bits[idx]) : "r" (~mask) : "cc");
+      start += n;
+      cnt -= n;
+    }
 }
 
 /* Returns the number of bits in B between START and START + CNT,
@@ -232,16 +298,22 @@ bitmap_set_multiple (struct bitmap *b, size_t start, size_t cnt, bool value)
 size_t
 bitmap_count (const struct bitmap *b, size_t start, size_t cnt, bool value) 
 {
-  size_t i, value_cnt;
+  size_t value_cnt;
 
   ASSERT (b != NULL);
   ASSERT (start <= b->bit_cnt);
   ASSERT (start + cnt <= b->bit_cnt);
 
   value_cnt = 0;
-  for (i = 0; i < cnt; i++)
-    if (bitmap_test (b, start + i) == value)
-      value_cnt++;
+  while (cnt > 0)
+    {
+      size_t ofs = start % ELEM_BITS;
+      size_t n = ELEM_BITS - ofs < cnt ? ELEM_BITS - ofs : cnt;
+      value_cnt += elem_popcount (elem_match (b, elem_idx (start), value)
+                                  & range_mask (ofs, n));
+      start += n;
+      cnt -= n;
+    }
   return value_cnt;
 }
 
@@ -250,16 +322,11 @@ bitmap_count (const struct bitmap *b, size_t start, size_t cnt, bool value)
 bool
 bitmap_contains (const struct bitmap *b, size_t start, size_t cnt, bool value) 
 {
-  size_t i;
-  
   ASSERT (b != NULL);
   ASSERT (start <= b->bit_cnt);
   ASSERT (start + cnt <= b->bit_cnt);
 
-  for (i = 0; i < cnt; i++)
-    if (bitmap_test (b, start + i) == value)
-      return true;
-  return false;
+  return cnt > 0 && find_bit (b, start, value) < start + cnt;
 }
 
 /* Returns true if any bits in B between START and START + CNT,
@@ -301,10 +368,17 @@ bitmap_scan (const struct bitmap *b, size_t start, size_t cnt, bool value)
   if (cnt <= b->bit_cnt) 
     {
       size_t last = b->bit_cnt - cnt;
-      size_t i;
-      for (i = start; i <= last; i++)
-        if (!bitmap_contains (b, i, cnt, !value))
-          return i; 
+      size_t i = start;
+      if (cnt == 0)
+        return i <= last ? i : BITMAP_ERROR;
+      /* Jump from run to run of bits set to VALUE */
+      while ((i = find_bit (b, i, value)) <= last)
+        {
+          size_t end = find_bit (b, i, !value);
+          if (end - i >= cnt)
+            return i;
+          i = end;
+        }
     }
   return BITMAP_ERROR;
 }
@@ -358,6 +432,30 @@ bitmap_write (const struct bitmap *b, struct file *file)
   off_t size = byte_cnt (b->bit_cnt);
   return file_write_at (file, b->bits, size, 0) == size;
 }
+
+/* Writes the part of B that holds the CNT bits starting at START
+   to FILE, rounded out to whole elements.  Return true if
+   successful, false otherwise. */
+bool
+bitmap_write_range (const struct bitmap *b, struct file *file,
+                    size_t start, size_t cnt)
+{
+  size_t first, last;
+  off_t ofs, size;
+
+  ASSERT (b != NULL);
+  ASSERT (start <= b->bit_cnt);
+  if (cnt > b->bit_cnt - start)
+    cnt = b->bit_cnt - start;
+  if (cnt == 0)
+    return true;
+
+  first = elem_idx (start);
+  last = elem_idx (start + cnt - 1);
+  ofs = first * sizeof *b->bits;
+  size = (last - first + 1) * sizeof *b->bits;
+  return file_write_at (file, b->bits + first, size, ofs) == size;
+}
 #endif /* FILESYS */
 
 /* Debugging. */
@@ -0,0 +1,136 @@
+#include "lz.h"
+#include <string.h>
+#include "debug.h"
+
+/* A small LZ77 codec in the style of LZSS.
+
+   The compressed stream is a sequence of groups.  Each group starts
+   with a control byte whose bits, least significant first, tell
+   what each of the following up to 8 items is:
+
+   - 0: a literal byte, copied as is.
+   - 1: a match of 2 bytes.  The low 12 bits of the little-endian
+     16-bit value are the distance back into the output minus 1, the
+     high 4 bits are the length minus LZ_MIN_MATCH.
+
+   Matches are found through a hash table of the last position at
+   which each 3-byte prefix occurred, so compression is a single
+   pass.  Decompression stops when the output buffer is full, so a
+   stream may be followed by padding. */
+
+#define LZ_MIN_MATCH 3
+#define LZ_MAX_MATCH (LZ_MIN_MATCH + 15)
+#define LZ_WINDOW 4096
+
+/* Returns the hash table slot for the 3 bytes at P. */
+static inline unsigned
+hash3 (const uint8_t *p)
+{
+  unsigned v = p[0] | (p[1] << 8) | (p[2] << 16);
+  return (v * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
+
+/* Compresses the SRC_LEN bytes at SRC, which must be fewer than
+   65535, into the DST_LEN bytes at DST.  WORK must point to
+   LZ_WORK_SIZE bytes of scratch memory.
+   Returns the length of the compressed data, or 0 if it does not
+   fit into DST_LEN bytes. */
+size_t
+lz_compress (const void *src_, size_t src_len,
+             void *dst_, size_t dst_len, void *work)
+{
+  const uint8_t *src = src_;
+  uint8_t *dst = dst_;
+  uint16_t *table = work;       /* Position + 1, 0 if none. */
+  size_t in = 0, out = 0, ctrl = 0;
+  int bit = 8;
+
+  ASSERT (src_len < UINT16_MAX);
+  memset (table, 0, LZ_WORK_SIZE);
+  while (in < src_len)
+    {
+      size_t len = 0, dist = 0;
+
+      if (bit == 8)
+        {
+          if (out >= dst_len)
+            return 0;
+          ctrl = out++;
+          dst[ctrl] = 0;
+          bit = 0;
+        }
+
+      if (in + LZ_MIN_MATCH <= src_len)
+        {
+          unsigned h = hash3 (src + in);
+          size_t cand = table[h];
+          table[h] = in + 1;
+          if (cand != 0 && in - (cand - 1) <= LZ_WINDOW)
+            {
+              size_t max = src_len - in < LZ_MAX_MATCH
+                           ? src_len - in : LZ_MAX_MATCH;
+              cand--;
+              while (len < max && src[cand + len] == src[in + len])
+                len++;
+              dist = in - cand;
+            }
+        }
+
+      if (len >= LZ_MIN_MATCH)
+        {
+          size_t i;
+          if (out + 2 > dst_len)
+            return 0;
+          dst[ctrl] |= 1 << bit;
+          dst[out++] = (dist - 1) & 0xff;
+          dst[out++] = ((dist - 1) >> 8) | ((len - LZ_MIN_MATCH) << 4);
+          for (i = 1; i < len && in + i + LZ_MIN_MATCH <= src_len; i++)
+            table[hash3 (src + in + i)] = in + i + 1;
+          in += len;
+        }
+      else
+        {
+          if (out >= dst_len)
+            return 0;
+          dst[out++] = src[in++];
+        }
+      bit++;
+    }
+  return out;
+}
+
+/* Decompresses the SRC_LEN bytes at SRC into the DST_LEN bytes at
+   DST, stopping once DST is full.  Returns the number of bytes
+   stored into DST, which is less than DST_LEN if SRC ends early or
+   is corrupt. */
+size_t
+lz_decompress (const void *src_, size_t src_len, void *dst_, size_t dst_len)
+{
+  const uint8_t *src = src_;
+  uint8_t *dst = dst_;
+  size_t in = 0, out = 0;
+
+  while (in < src_len && out < dst_len)
+    {
+      uint8_t ctrl = src[in++];
+      int bit;
+
+      for (bit = 0; bit < 8 && in < src_len && out < dst_len; bit++)
+        if (ctrl & (1 << bit))
+          {
+            size_t dist, len;
+            if (in + 2 > src_len)
+              return out;
+            dist = (src[in] | ((src[in + 1] & 0x0f) << 8)) + 1;
+            len = (src[in + 1] >> 4) + LZ_MIN_MATCH;
+            in += 2;
+            if (dist > out)
+              return out;
+            for (; len > 0 && out < dst_len; len--, out++)
+              dst[out] = dst[out - dist];
+          }
+        else
+          dst[out++] = src[in++];
+    }
+  return out;
+}
@@ -0,0 +1,16 @@
+#ifndef __LIB_LZ_H
+#define __LIB_LZ_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Bytes of scratch memory lz_compress() needs. */
+#define LZ_HASH_BITS 10
+#define LZ_WORK_SIZE ((1 << LZ_HASH_BITS) * sizeof (uint16_t))
+
+size_t lz_compress (const void *src, size_t src_len,
+                    void *dst, size_t dst_len, void *work);
+size_t lz_decompress (const void *src, size_t src_len,
+                      void *dst, size_t dst_len);
+
+#endif /* lib/lz.h */
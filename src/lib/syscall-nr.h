@@ -28,7 +28,15 @@ enum
     SYS_MKDIR,                  /* Create a directory. */
     SYS_READDIR,                /* Reads a directory entry. */
     SYS_ISDIR,                  /* Tests if a fd represents a directory. */
-    SYS_INUMBER                 /* Returns the inode number for a fd. */
+    SYS_INUMBER,                /* Returns the inode number for a fd. */
+
+    /* Extensions. */
+    SYS_FALLOCATE,              /* Reserves disk space for a fd. */
+    SYS_SEEK_DATA,              /* Finds the next data or hole of a fd. */
+    SYS_CLONE,                  /* Creates a copy-on-write copy of a file. */
+    SYS_GETDENTS,               /* Reads several directory entries. */
+    SYS_DEFRAG,                 /* Makes the sectors of a fd contiguous. */
+    SYS_DIRECTIO                /* Makes I/O of a fd bypass the cache. */
   };
 
 #endif /* lib/syscall-nr.h */
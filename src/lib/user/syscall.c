@@ -182,3 +182,39 @@ inumber (int fd)
 {
   return syscall1 (SYS_INUMBER, fd);
 }
+
+bool
+fallocate (int fd, unsigned offset, unsigned length)
+{
+  return syscall3 (SYS_FALLOCATE, fd, offset, length);
+}
+
+int
+seek_data (int fd, unsigned position, int whence)
+{
+  return syscall3 (SYS_SEEK_DATA, fd, position, whence);
+}
+
+bool
+clone (const char *file, const char *new_file)
+{
+  return syscall2 (SYS_CLONE, file, new_file);
+}
+
+int
+getdents (int fd, struct dirent *entries, unsigned cnt)
+{
+  return syscall3 (SYS_GETDENTS, fd, entries, cnt);
+}
+
+bool
+defrag (int fd, struct defrag_stats *stats)
+{
+  return syscall2 (SYS_DEFRAG, fd, stats);
+}
+
+bool
+directio (int fd, bool enable)
+{
+  return syscall2 (SYS_DIRECTIO, fd, (int) enable);
+}
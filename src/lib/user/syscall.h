@@ -15,6 +15,28 @@ typedef int mapid_t;
 /* Maximum characters in a filename written by readdir(). */
 #define READDIR_MAX_LEN 14
 
+/* A directory entry written by getdents(). */
+struct dirent
+  {
+    int inumber;                /* Inode number of the entry. */
+    bool is_dir;                /* Is the entry a directory? */
+    char name[READDIR_MAX_LEN + 1];     /* Null terminated file name. */
+  };
+
+/* Layout of a file before and after defrag(). */
+struct defrag_stats
+  {
+    unsigned sectors;           /* Data sectors of the file. */
+    unsigned extents_before;    /* Runs of consecutive sectors before. */
+    unsigned extents_after;     /* Runs of consecutive sectors after. */
+    unsigned free_extents_before;  /* Runs of free sectors before. */
+    unsigned free_extents_after;   /* Runs of free sectors after. */
+  };
+
+/* Values for WHENCE of seek_data(). */
+#define SEEK_DATA 0             /* Next offset that holds data. */
+#define SEEK_HOLE 1             /* Next offset inside a hole. */
+
 /* Typical return values from main() and arguments to exit(). */
 #define EXIT_SUCCESS 0          /* Successful execution. */
 #define EXIT_FAILURE 1          /* Unsuccessful execution. */
@@ -45,4 +67,12 @@ bool readdir (int fd, char name[READDIR_MAX_LEN + 1]);
 bool isdir (int fd);
 int inumber (int fd);
 
+/* Extensions. */
+bool fallocate (int fd, unsigned offset, unsigned length);
+int seek_data (int fd, unsigned position, int whence);
+bool clone (const char *file, const char *new_file);
+int getdents (int fd, struct dirent *entries, unsigned cnt);
+bool defrag (int fd, struct defrag_stats *stats);
+bool directio (int fd, bool enable);
+
 #endif /* lib/user/syscall.h */
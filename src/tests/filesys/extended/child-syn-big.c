@@ -0,0 +1,40 @@
+/* Child process for syn-big.
+   Writes its own file in chunks that do not line up with sectors,
+   while the other children do the same, so that together they
+   dirty more sectors than the cache holds. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/filesys/extended/syn-big.h"
+#include "tests/lib.h"
+
+const char *test_name = "child-syn-big";
+
+static char buf[CHUNK_SIZE];
+
+int
+main (int argc, const char *argv[]) 
+{
+  char name[16];
+  int child_idx;
+  int fd, chunk;
+
+  quiet = true;
+
+  CHECK (argc == 2, "argc must be 2, actually %d", argc);
+  child_idx = atoi (argv[1]);
+
+  snprintf (name, sizeof name, "big%d", child_idx);
+  CHECK ((fd = open (name)) > 1, "open \"%s\"", name);
+  for (chunk = 0; chunk < CHUNK_CNT; chunk++)
+    {
+      memset (buf, CHUNK_BYTE (child_idx, chunk), sizeof buf);
+      CHECK (write (fd, buf, sizeof buf) == (int) sizeof buf,
+             "write chunk %d of \"%s\"", chunk, name);
+    }
+  close (fd);
+
+  return child_idx;
+}
@@ -0,0 +1,47 @@
+/* Child process for syn-create.
+   Creates and writes FILE_CNT files in its own directory, made by
+   the parent, while the other children do the same in theirs, then
+   checks them. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/filesys/extended/syn-create.h"
+#include "tests/lib.h"
+
+const char *test_name = "child-syn-create";
+
+static char buf[FILE_SIZE];
+
+int
+main (int argc, const char *argv[]) 
+{
+  char name[16];
+  int child_idx;
+  int fd, i;
+
+  quiet = true;
+
+  CHECK (argc == 2, "argc must be 2, actually %d", argc);
+  child_idx = atoi (argv[1]);
+
+  for (i = 0; i < FILE_CNT; i++)
+    {
+      snprintf (name, sizeof name, "d%d/f%d", child_idx, i);
+      memset (buf, FILE_BYTE (child_idx, i), sizeof buf);
+      CHECK (create (name, 0), "create \"%s\"", name);
+      CHECK ((fd = open (name)) > 1, "open \"%s\"", name);
+      CHECK (write (fd, buf, sizeof buf) == (int) sizeof buf,
+             "write \"%s\"", name);
+      close (fd);
+    }
+  for (i = 0; i < FILE_CNT; i++)
+    {
+      snprintf (name, sizeof name, "d%d/f%d", child_idx, i);
+      memset (buf, FILE_BYTE (child_idx, i), sizeof buf);
+      check_file (name, buf, sizeof buf);
+    }
+
+  return child_idx;
+}
@@ -0,0 +1,41 @@
+/* Child process for syn-range.
+   Writes every CHILD_CNT'th chunk of a file created by our parent,
+   while the other children write the chunks in between.  Chunks
+   share sectors and most writes extend the file past chunks that
+   another child has not written yet. */
+
+#include <stdlib.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/filesys/extended/syn-range.h"
+#include "tests/lib.h"
+
+const char *test_name = "child-syn-range";
+
+static char buf[CHUNK_SIZE];
+
+int
+main (int argc, const char *argv[]) 
+{
+  int child_idx;
+  int fd, round;
+
+  quiet = true;
+
+  CHECK (argc == 2, "argc must be 2, actually %d", argc);
+  child_idx = atoi (argv[1]);
+
+  CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+  for (round = 0; round < ROUND_CNT; round++)
+    {
+      size_t ofs = (round * CHILD_CNT + child_idx) * CHUNK_SIZE;
+      memset (buf, CHUNK_BYTE (child_idx, round), sizeof buf);
+      seek (fd, ofs);
+      CHECK (write (fd, buf, sizeof buf) == (int) sizeof buf,
+             "write %d bytes at offset %zu in \"%s\"",
+             CHUNK_SIZE, ofs, file_name);
+    }
+  close (fd);
+
+  return child_idx;
+}
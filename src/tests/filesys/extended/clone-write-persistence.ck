@@ -0,0 +1,9 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+my ($pattern) = join ('', map (chr (ord ('a') + $_ % 26), 0...2999));
+check_archive ({"b" => [substr ($pattern, 0, 1000) . 'B' x 500
+			. substr ($pattern, 1500) . 'C' x 1000],
+		"d" => {}});
+pass;
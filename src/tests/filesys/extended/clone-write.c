@@ -0,0 +1,69 @@
+/* Clones a file and writes to the clone and to the original in
+   turn, checking after each write that only the file written to
+   has changed.  Then removes the original and checks that the
+   clone keeps its sectors. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FILE_SIZE 3000
+
+static char a_buf[FILE_SIZE];
+static char b_buf[FILE_SIZE + 1000];
+
+/* Writes CNT bytes from BUF + OFS to FILE_NAME at OFS. */
+static void
+write_at (const char *file_name, char *buf, size_t ofs, size_t cnt)
+{
+  int fd;
+
+  CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+  msg ("seek \"%s\" to %zu", file_name, ofs);
+  seek (fd, ofs);
+  CHECK (write (fd, buf + ofs, cnt) == (int) cnt,
+         "write %zu bytes to \"%s\"", cnt, file_name);
+  msg ("close \"%s\"", file_name);
+  close (fd);
+}
+
+void
+test_main (void) 
+{
+  size_t i;
+  int fd;
+
+  for (i = 0; i < FILE_SIZE; i++)
+    a_buf[i] = 'a' + i % 26;
+  CHECK (create ("a", 0), "create \"a\"");
+  write_at ("a", a_buf, 0, FILE_SIZE);
+
+  CHECK (clone ("a", "b"), "clone \"a\" to \"b\"");
+  CHECK (!clone ("a", "b"), "clone \"a\" to \"b\" again (must fail)");
+  CHECK (mkdir ("d"), "mkdir \"d\"");
+  CHECK (!clone ("d", "e"), "clone directory \"d\" (must fail)");
+  memcpy (b_buf, a_buf, FILE_SIZE);
+  check_file ("b", b_buf, FILE_SIZE);
+
+  /* A write to the clone */
+  memset (b_buf + 1000, 'B', 500);
+  write_at ("b", b_buf, 1000, 500);
+  check_file ("a", a_buf, FILE_SIZE);
+  check_file ("b", b_buf, FILE_SIZE);
+
+  /* A write to the original, in a sector the clone did not copy */
+  memset (a_buf + 2000, 'A', 500);
+  write_at ("a", a_buf, 2000, 500);
+  check_file ("a", a_buf, FILE_SIZE);
+  check_file ("b", b_buf, FILE_SIZE);
+
+  /* The clone grows on its own */
+  memset (b_buf + FILE_SIZE, 'C', 1000);
+  write_at ("b", b_buf, FILE_SIZE, 1000);
+  check_file ("a", a_buf, FILE_SIZE);
+
+  CHECK (remove ("a"), "remove \"a\"");
+  CHECK ((fd = open ("a")) == -1, "open \"a\" (must fail)");
+  check_file ("b", b_buf, sizeof b_buf);
+}
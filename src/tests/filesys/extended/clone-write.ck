@@ -0,0 +1,53 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(clone-write) begin
+(clone-write) create "a"
+(clone-write) open "a"
+(clone-write) seek "a" to 0
+(clone-write) write 3000 bytes to "a"
+(clone-write) close "a"
+(clone-write) clone "a" to "b"
+(clone-write) clone "a" to "b" again (must fail)
+(clone-write) mkdir "d"
+(clone-write) clone directory "d" (must fail)
+(clone-write) open "b" for verification
+(clone-write) verified contents of "b"
+(clone-write) close "b"
+(clone-write) open "b"
+(clone-write) seek "b" to 1000
+(clone-write) write 500 bytes to "b"
+(clone-write) close "b"
+(clone-write) open "a" for verification
+(clone-write) verified contents of "a"
+(clone-write) close "a"
+(clone-write) open "b" for verification
+(clone-write) verified contents of "b"
+(clone-write) close "b"
+(clone-write) open "a"
+(clone-write) seek "a" to 2000
+(clone-write) write 500 bytes to "a"
+(clone-write) close "a"
+(clone-write) open "a" for verification
+(clone-write) verified contents of "a"
+(clone-write) close "a"
+(clone-write) open "b" for verification
+(clone-write) verified contents of "b"
+(clone-write) close "b"
+(clone-write) open "b"
+(clone-write) seek "b" to 3000
+(clone-write) write 1000 bytes to "b"
+(clone-write) close "b"
+(clone-write) open "a" for verification
+(clone-write) verified contents of "a"
+(clone-write) close "a"
+(clone-write) remove "a"
+(clone-write) open "a" (must fail)
+(clone-write) open "b" for verification
+(clone-write) verified contents of "b"
+(clone-write) close "b"
+(clone-write) end
+EOF
+pass;
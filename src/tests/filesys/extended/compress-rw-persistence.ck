@@ -0,0 +1,10 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+use tests::random;
+my ($data) = 'a' x 2000 . 'B' x 100 . 'a' x 1996 . random_bytes (4096)
+  . substr ('0123456789' x 410, 0, 4096) . 'z' x 4086 . 'Y' x 10
+  . 'q' x 1000;
+check_archive ({"c" => [$data]});
+pass;
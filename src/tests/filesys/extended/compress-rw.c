@@ -0,0 +1,71 @@
+/* Run with -o=compress.  Writes a file of 4 kB clusters that
+   compress well, not at all, and somewhat, checks that it takes
+   fewer sectors than its size, then overwrites parts of clusters
+   and appends a partial cluster.  The file must read back right
+   after each step. */
+
+#include <random.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define CLUSTER 4096
+#define FILE_SIZE (4 * CLUSTER)
+#define TAIL_SIZE 1000
+
+static char buf[FILE_SIZE + TAIL_SIZE];
+
+/* Writes CNT bytes of BUF + OFS to "c" at OFS. */
+static void
+write_at (size_t ofs, size_t cnt)
+{
+  int fd;
+
+  CHECK ((fd = open ("c")) > 1, "open \"c\"");
+  msg ("seek \"c\" to %zu", ofs);
+  seek (fd, ofs);
+  CHECK (write (fd, buf + ofs, cnt) == (int) cnt,
+         "write %zu bytes to \"c\"", cnt);
+  msg ("close \"c\"");
+  close (fd);
+}
+
+void
+test_main (void) 
+{
+  struct defrag_stats stats;
+  size_t i;
+  int fd;
+
+  memset (buf, 'a', CLUSTER);
+  random_bytes (buf + CLUSTER, CLUSTER);
+  for (i = 0; i < CLUSTER; i++)
+    buf[2 * CLUSTER + i] = "0123456789"[i % 10];
+  memset (buf + 3 * CLUSTER, 'z', CLUSTER);
+
+  CHECK (create ("c", 0), "create \"c\"");
+  write_at (0, FILE_SIZE);
+  check_file ("c", buf, FILE_SIZE);
+  CHECK ((fd = open ("c")) > 1, "open \"c\"");
+  CHECK (defrag (fd, &stats), "get layout of \"c\"");
+  CHECK (stats.sectors < FILE_SIZE / 512,
+         "\"c\" takes fewer than %d data sectors", FILE_SIZE / 512);
+  msg ("close \"c\"");
+  close (fd);
+
+  /* The middle of a compressed cluster */
+  memset (buf + 2000, 'B', 100);
+  write_at (2000, 100);
+  check_file ("c", buf, FILE_SIZE);
+
+  /* The end of a compressed cluster, which compresses it again */
+  memset (buf + FILE_SIZE - 10, 'Y', 10);
+  write_at (FILE_SIZE - 10, 10);
+  check_file ("c", buf, FILE_SIZE);
+
+  /* A partial cluster stays uncompressed */
+  memset (buf + FILE_SIZE, 'q', TAIL_SIZE);
+  write_at (FILE_SIZE, TAIL_SIZE);
+  check_file ("c", buf, sizeof buf);
+}
@@ -0,0 +1,42 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(compress-rw) begin
+(compress-rw) create "c"
+(compress-rw) open "c"
+(compress-rw) seek "c" to 0
+(compress-rw) write 16384 bytes to "c"
+(compress-rw) close "c"
+(compress-rw) open "c" for verification
+(compress-rw) verified contents of "c"
+(compress-rw) close "c"
+(compress-rw) open "c"
+(compress-rw) get layout of "c"
+(compress-rw) "c" takes fewer than 32 data sectors
+(compress-rw) close "c"
+(compress-rw) open "c"
+(compress-rw) seek "c" to 2000
+(compress-rw) write 100 bytes to "c"
+(compress-rw) close "c"
+(compress-rw) open "c" for verification
+(compress-rw) verified contents of "c"
+(compress-rw) close "c"
+(compress-rw) open "c"
+(compress-rw) seek "c" to 16374
+(compress-rw) write 10 bytes to "c"
+(compress-rw) close "c"
+(compress-rw) open "c" for verification
+(compress-rw) verified contents of "c"
+(compress-rw) close "c"
+(compress-rw) open "c"
+(compress-rw) seek "c" to 16384
+(compress-rw) write 1000 bytes to "c"
+(compress-rw) close "c"
+(compress-rw) open "c" for verification
+(compress-rw) verified contents of "c"
+(compress-rw) close "c"
+(compress-rw) end
+EOF
+pass;
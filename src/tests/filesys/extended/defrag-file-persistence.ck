@@ -0,0 +1,8 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+my ($lower) = join ('', map (chr (ord ('a') + $_ % 26), 0...16383));
+my ($upper) = join ('', map (chr (ord ('A') + $_ % 26), 0...16383));
+check_archive ({"a" => [$lower], "b" => [$upper], "c" => [$upper]});
+pass;
@@ -0,0 +1,75 @@
+/* Grows two files in turns, reopening them for every sector so that
+   their sectors interleave, then defragments one of them, and a
+   clone of the other.  Defragmenting must not add extents and must
+   keep the contents of every file. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FILE_SIZE 16384
+
+static char buf_a[FILE_SIZE];
+static char buf_b[FILE_SIZE];
+
+/* Appends the 512 bytes at OFS of BUF to FILE_NAME. */
+static void
+append (const char *file_name, const char *buf, size_t ofs)
+{
+  int fd;
+
+  CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+  seek (fd, ofs);
+  CHECK (write (fd, buf + ofs, 512) == 512,
+         "write 512 bytes at offset %zu in \"%s\"", ofs, file_name);
+  close (fd);
+}
+
+/* Defragments FILE_NAME and checks its layout and contents. */
+static void
+defrag_file (const char *file_name, const char *buf)
+{
+  struct defrag_stats stats;
+  int fd;
+
+  CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+  CHECK (defrag (fd, &stats), "defrag \"%s\"", file_name);
+  CHECK (stats.sectors == FILE_SIZE / 512,
+         "\"%s\" has %d data sectors", file_name, FILE_SIZE / 512);
+  CHECK (stats.extents_after <= stats.extents_before,
+         "\"%s\" has no more extents than before", file_name);
+  msg ("close \"%s\"", file_name);
+  close (fd);
+  check_file (file_name, buf, FILE_SIZE);
+}
+
+void
+test_main (void) 
+{
+  size_t i, ofs;
+
+  for (i = 0; i < FILE_SIZE; i++)
+    {
+      buf_a[i] = 'a' + i % 26;
+      buf_b[i] = 'A' + i % 26;
+    }
+  CHECK (create ("a", 0), "create \"a\"");
+  CHECK (create ("b", 0), "create \"b\"");
+  msg ("append to \"a\" and \"b\" alternately");
+  quiet = true;
+  for (ofs = 0; ofs < FILE_SIZE; ofs += 512)
+    {
+      append ("a", buf_a, ofs);
+      append ("b", buf_b, ofs);
+    }
+  quiet = false;
+
+  defrag_file ("a", buf_a);
+  check_file ("b", buf_b, FILE_SIZE);
+
+  /* The sectors shared with "b" stay where they are */
+  CHECK (clone ("b", "c"), "clone \"b\" to \"c\"");
+  defrag_file ("c", buf_b);
+  check_file ("b", buf_b, FILE_SIZE);
+}
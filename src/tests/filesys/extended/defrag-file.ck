@@ -0,0 +1,35 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(defrag-file) begin
+(defrag-file) create "a"
+(defrag-file) create "b"
+(defrag-file) append to "a" and "b" alternately
+(defrag-file) open "a"
+(defrag-file) defrag "a"
+(defrag-file) "a" has 32 data sectors
+(defrag-file) "a" has no more extents than before
+(defrag-file) close "a"
+(defrag-file) open "a" for verification
+(defrag-file) verified contents of "a"
+(defrag-file) close "a"
+(defrag-file) open "b" for verification
+(defrag-file) verified contents of "b"
+(defrag-file) close "b"
+(defrag-file) clone "b" to "c"
+(defrag-file) open "c"
+(defrag-file) defrag "c"
+(defrag-file) "c" has 32 data sectors
+(defrag-file) "c" has no more extents than before
+(defrag-file) close "c"
+(defrag-file) open "c" for verification
+(defrag-file) verified contents of "c"
+(defrag-file) close "c"
+(defrag-file) open "b" for verification
+(defrag-file) verified contents of "b"
+(defrag-file) close "b"
+(defrag-file) end
+EOF
+pass;
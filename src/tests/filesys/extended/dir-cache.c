@@ -0,0 +1,42 @@
+/* Looks up names before and after they are created or removed, so
+   that stale positive or negative entries in the lookup cache
+   would show.  Also replaces a removed directory by a new one of
+   the same name, which must not inherit the old entries. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  int fd;
+
+  CHECK (open ("a") == -1, "open \"a\" (must fail)");
+  CHECK (create ("a", 0), "create \"a\"");
+  CHECK ((fd = open ("a")) > 1, "open \"a\"");
+  msg ("close \"a\"");
+  close (fd);
+
+  CHECK (create ("b", 0), "create \"b\"");
+  CHECK ((fd = open ("b")) > 1, "open \"b\"");
+  msg ("close \"b\"");
+  close (fd);
+  CHECK (remove ("b"), "remove \"b\"");
+  CHECK (open ("b") == -1, "open \"b\" (must fail)");
+
+  CHECK (mkdir ("d"), "mkdir \"d\"");
+  CHECK (create ("d/f", 0), "create \"d/f\"");
+  CHECK ((fd = open ("d/f")) > 1, "open \"d/f\"");
+  msg ("close \"d/f\"");
+  close (fd);
+  CHECK (remove ("d/f"), "remove \"d/f\"");
+  CHECK (remove ("d"), "remove \"d\"");
+  CHECK (open ("d/f") == -1, "open \"d/f\" (must fail)");
+  CHECK (mkdir ("d"), "mkdir \"d\"");
+  CHECK (open ("d/f") == -1, "open \"d/f\" in new \"d\" (must fail)");
+  CHECK (create ("d/g", 0), "create \"d/g\"");
+  CHECK ((fd = open ("d/g")) > 1, "open \"d/g\"");
+  msg ("close \"d/g\"");
+  close (fd);
+}
@@ -0,0 +1,30 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(dir-cache) begin
+(dir-cache) open "a" (must fail)
+(dir-cache) create "a"
+(dir-cache) open "a"
+(dir-cache) close "a"
+(dir-cache) create "b"
+(dir-cache) open "b"
+(dir-cache) close "b"
+(dir-cache) remove "b"
+(dir-cache) open "b" (must fail)
+(dir-cache) mkdir "d"
+(dir-cache) create "d/f"
+(dir-cache) open "d/f"
+(dir-cache) close "d/f"
+(dir-cache) remove "d/f"
+(dir-cache) remove "d"
+(dir-cache) open "d/f" (must fail)
+(dir-cache) mkdir "d"
+(dir-cache) open "d/f" in new "d" (must fail)
+(dir-cache) create "d/g"
+(dir-cache) open "d/g"
+(dir-cache) close "d/g"
+(dir-cache) end
+EOF
+pass;
@@ -0,0 +1,9 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+my ($fs);
+$fs->{'d'}{"f$_"} = [''] foreach 0...29;
+$fs->{'d'}{"s$_"} = {} foreach 0...2;
+check_archive ($fs);
+pass;
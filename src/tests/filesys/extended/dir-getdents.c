@@ -0,0 +1,89 @@
+/* Lists a directory of files and subdirectories with getdents() in
+   batches, and checks that every entry shows up once with the
+   right type and inode number.  Also checks that getdents() fails
+   on a file. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FILE_CNT 30
+#define DIR_CNT 3
+#define BATCH_CNT 7
+
+static struct dirent entries[BATCH_CNT];
+
+/* Returns the inode number of NAME in "d". */
+static int
+inumber_of (const char *name)
+{
+  char path[32];
+  int fd, inum;
+
+  snprintf (path, sizeof path, "d/%s", name);
+  CHECK ((fd = open (path)) > 1, "open \"%s\"", path);
+  inum = inumber (fd);
+  close (fd);
+  return inum;
+}
+
+void
+test_main (void) 
+{
+  static bool seen[FILE_CNT + DIR_CNT];
+  char name[16];
+  int fd, i, n, listed = 0;
+
+  CHECK (mkdir ("d"), "mkdir \"d\"");
+  msg ("create %d files and %d directories in \"d\"", FILE_CNT, DIR_CNT);
+  quiet = true;
+  for (i = 0; i < FILE_CNT; i++)
+    {
+      snprintf (name, sizeof name, "d/f%d", i);
+      CHECK (create (name, 0), "create \"%s\"", name);
+    }
+  for (i = 0; i < DIR_CNT; i++)
+    {
+      snprintf (name, sizeof name, "d/s%d", i);
+      CHECK (mkdir (name), "mkdir \"%s\"", name);
+    }
+  quiet = false;
+
+  CHECK ((fd = open ("d")) > 1, "open \"d\"");
+  msg ("list \"d\" %d entries at a time", BATCH_CNT);
+  quiet = true;
+  while ((n = getdents (fd, entries, BATCH_CNT)) > 0)
+    for (i = 0; i < n; i++)
+      {
+        struct dirent *e = &entries[i];
+        bool is_dir = e->name[0] == 's';
+        int idx = atoi (e->name + 1) + (is_dir ? FILE_CNT : 0);
+
+        CHECK ((e->name[0] == 'f' && idx < FILE_CNT)
+               || (is_dir && idx < FILE_CNT + DIR_CNT),
+               "\"%s\" was created", e->name);
+        CHECK (!seen[idx], "\"%s\" is listed once", e->name);
+        seen[idx] = true;
+        CHECK (e->is_dir == is_dir, "\"%s\" has the right type", e->name);
+        CHECK (e->inumber == inumber_of (e->name),
+               "\"%s\" has the right inode number", e->name);
+        listed++;
+      }
+  quiet = false;
+  CHECK (n == 0, "getdents at the end of \"d\" returns 0");
+  CHECK (getdents (fd, entries, BATCH_CNT) == 0,
+         "getdents after the end of \"d\" returns 0");
+  CHECK (listed == FILE_CNT + DIR_CNT, "listed %d entries",
+         FILE_CNT + DIR_CNT);
+  msg ("close \"d\"");
+  close (fd);
+
+  CHECK ((fd = open ("d/f0")) > 1, "open \"d/f0\"");
+  CHECK (getdents (fd, entries, BATCH_CNT) == -1,
+         "getdents on \"d/f0\" (must return -1)");
+  msg ("close \"d/f0\"");
+  close (fd);
+}
@@ -0,0 +1,20 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(dir-getdents) begin
+(dir-getdents) mkdir "d"
+(dir-getdents) create 30 files and 3 directories in "d"
+(dir-getdents) open "d"
+(dir-getdents) list "d" 7 entries at a time
+(dir-getdents) getdents at the end of "d" returns 0
+(dir-getdents) getdents after the end of "d" returns 0
+(dir-getdents) listed 33 entries
+(dir-getdents) close "d"
+(dir-getdents) open "d/f0"
+(dir-getdents) getdents on "d/f0" (must return -1)
+(dir-getdents) close "d/f0"
+(dir-getdents) end
+EOF
+pass;
@@ -0,0 +1,104 @@
+/* Fills a linear directory up to the point where the next entry
+   turns it into a hash table, fills the disk, and then adds entries
+   to it.  The rebuild cannot get the sectors it needs, so the
+   entries are either added to the old layout or not at all, but
+   every entry already in the directory must survive.  Once there
+   is space again the directory has to grow normally. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define OLD_CNT 25
+#define TRY_CNT 5
+#define NEW_CNT 40
+
+static char buf[4096];
+
+/* Checks that "d/f0" to "d/fCNT-1" exist and are listed once, and
+   that the listing of "d" holds no other names. */
+static void
+check_dir (int cnt)
+{
+  static bool seen[NEW_CNT];
+  char name[READDIR_MAX_LEN + 1];
+  int fd, i;
+
+  msg ("check that \"d\" holds \"f0\" to \"f%d\"", cnt - 1);
+  quiet = true;
+  for (i = 0; i < cnt; i++)
+    {
+      snprintf (name, sizeof name, "d/f%d", i);
+      CHECK ((fd = open (name)) > 1, "open \"%s\"", name);
+      close (fd);
+    }
+
+  memset (seen, 0, sizeof seen);
+  CHECK ((fd = open ("d")) > 1, "open \"d\"");
+  while (readdir (fd, name))
+    {
+      i = atoi (name + 1);
+      CHECK (name[0] == 'f' && i >= 0 && i < NEW_CNT, "\"%s\" was created",
+             name);
+      CHECK (!seen[i], "\"%s\" is listed once", name);
+      seen[i] = true;
+    }
+  close (fd);
+  for (i = 0; i < cnt; i++)
+    CHECK (seen[i], "\"d/f%d\" is listed", i);
+  quiet = false;
+}
+
+void
+test_main (void) 
+{
+  char name[16];
+  int fd, i;
+
+  CHECK (mkdir ("d"), "mkdir \"d\"");
+  msg ("create %d files in \"d\"", OLD_CNT);
+  quiet = true;
+  for (i = 0; i < OLD_CNT; i++)
+    {
+      snprintf (name, sizeof name, "d/f%d", i);
+      CHECK (create (name, 0), "create \"%s\"", name);
+    }
+  quiet = false;
+
+  /* Fill the disk, then free a single data sector */
+  CHECK (create ("spare", 512), "create \"spare\"");
+  CHECK (create ("fill", 0), "create \"fill\"");
+  CHECK ((fd = open ("fill")) > 1, "open \"fill\"");
+  msg ("write \"fill\" until the disk is full");
+  while (write (fd, buf, sizeof buf) == (int) sizeof buf)
+    continue;
+  while (write (fd, buf, 512) == 512)
+    continue;
+  msg ("close \"fill\"");
+  close (fd);
+  CHECK (remove ("spare"), "remove \"spare\"");
+
+  /* May or may not succeed */
+  msg ("create %d more files in \"d\"", TRY_CNT);
+  for (i = OLD_CNT; i < OLD_CNT + TRY_CNT; i++)
+    {
+      snprintf (name, sizeof name, "d/f%d", i);
+      create (name, 0);
+    }
+  check_dir (OLD_CNT);
+
+  CHECK (remove ("fill"), "remove \"fill\"");
+  msg ("create \"f%d\" to \"f%d\" in \"d\"", OLD_CNT, NEW_CNT - 1);
+  quiet = true;
+  for (i = OLD_CNT; i < NEW_CNT; i++)
+    {
+      snprintf (name, sizeof name, "d/f%d", i);
+      remove (name);
+      CHECK (create (name, 0), "create \"%s\"", name);
+    }
+  quiet = false;
+  check_dir (NEW_CNT);
+}
@@ -0,0 +1,22 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(dir-grow-full) begin
+(dir-grow-full) mkdir "d"
+(dir-grow-full) create 25 files in "d"
+(dir-grow-full) create "spare"
+(dir-grow-full) create "fill"
+(dir-grow-full) open "fill"
+(dir-grow-full) write "fill" until the disk is full
+(dir-grow-full) close "fill"
+(dir-grow-full) remove "spare"
+(dir-grow-full) create 5 more files in "d"
+(dir-grow-full) check that "d" holds "f0" to "f24"
+(dir-grow-full) remove "fill"
+(dir-grow-full) create "f25" to "f39" in "d"
+(dir-grow-full) check that "d" holds "f0" to "f39"
+(dir-grow-full) end
+EOF
+pass;
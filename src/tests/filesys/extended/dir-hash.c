@@ -0,0 +1,81 @@
+/* Fills a directory with enough files to turn it into a hash table
+   that has to grow twice, then removes most of them again, so that
+   it shrinks back to a linear directory.  Checks lookups and
+   listings of the directory at both sizes. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FILE_CNT 100
+#define KEEP_CNT 10
+
+/* Checks that exactly the files "d/f0" to "d/fCNT-1" exist, by
+   looking up every name that was created and by listing "d". */
+static void
+check_dir (int cnt)
+{
+  static bool seen[FILE_CNT];
+  char name[READDIR_MAX_LEN + 1];
+  int fd, i, listed = 0;
+
+  msg ("check that \"d\" holds %d files", cnt);
+  quiet = true;
+  for (i = 0; i < FILE_CNT; i++)
+    {
+      snprintf (name, sizeof name, "d/f%d", i);
+      if (i < cnt)
+        {
+          CHECK ((fd = open (name)) > 1, "open \"%s\"", name);
+          close (fd);
+        }
+      else
+        CHECK (open (name) == -1, "open \"%s\" (must fail)", name);
+    }
+
+  memset (seen, 0, sizeof seen);
+  CHECK ((fd = open ("d")) > 1, "open \"d\"");
+  while (readdir (fd, name))
+    {
+      i = atoi (name + 1);
+      CHECK (name[0] == 'f' && i >= 0 && i < cnt, "\"%s\" was created",
+             name);
+      CHECK (!seen[i], "\"%s\" is listed once", name);
+      seen[i] = true;
+      listed++;
+    }
+  close (fd);
+  quiet = false;
+  CHECK (listed == cnt, "listed %d files in \"d\"", cnt);
+}
+
+void
+test_main (void) 
+{
+  char name[16];
+  int i;
+
+  CHECK (mkdir ("d"), "mkdir \"d\"");
+  msg ("create %d files in \"d\"", FILE_CNT);
+  quiet = true;
+  for (i = 0; i < FILE_CNT; i++)
+    {
+      snprintf (name, sizeof name, "d/f%d", i);
+      CHECK (create (name, 0), "create \"%s\"", name);
+    }
+  quiet = false;
+  check_dir (FILE_CNT);
+
+  msg ("remove all but %d files from \"d\"", KEEP_CNT);
+  quiet = true;
+  for (i = FILE_CNT - 1; i >= KEEP_CNT; i--)
+    {
+      snprintf (name, sizeof name, "d/f%d", i);
+      CHECK (remove (name), "remove \"%s\"", name);
+    }
+  quiet = false;
+  check_dir (KEEP_CNT);
+}
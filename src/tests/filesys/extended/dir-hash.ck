@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(dir-hash) begin
+(dir-hash) mkdir "d"
+(dir-hash) create 100 files in "d"
+(dir-hash) check that "d" holds 100 files
+(dir-hash) listed 100 files in "d"
+(dir-hash) remove all but 10 files from "d"
+(dir-hash) check that "d" holds 10 files
+(dir-hash) listed 10 files in "d"
+(dir-hash) end
+EOF
+pass;
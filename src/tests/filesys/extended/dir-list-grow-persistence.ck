@@ -0,0 +1,9 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+my ($fs);
+$fs->{'lin'}{"f$_"} = [''] foreach 5...39;
+$fs->{'hash'}{"f$_"} = [''] foreach 20...69;
+check_archive ($fs);
+pass;
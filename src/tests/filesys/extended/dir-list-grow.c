@@ -0,0 +1,141 @@
+/* Grows and shrinks directories while a listing of them is in
+   progress.  A linear directory grows past the size at which it
+   would become a hash table, and a hash table fills up completely
+   and spills into overflow slots.  The listing must not repeat a
+   name and must return every name that existed during all of it.
+   Once the listing is done, every file must still be found. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define MAX_CNT 100
+
+/* Creates "DIR/fFIRST" to "DIR/fLAST-1". */
+static void
+create_files (const char *dir, int first, int last)
+{
+  char name[32];
+  int i;
+
+  msg ("create \"f%d\" to \"f%d\" in \"%s\"", first, last - 1, dir);
+  quiet = true;
+  for (i = first; i < last; i++)
+    {
+      snprintf (name, sizeof name, "%s/f%d", dir, i);
+      CHECK (create (name, 0), "create \"%s\"", name);
+    }
+  quiet = false;
+}
+
+/* Removes "DIR/fFIRST" to "DIR/fLAST-1". */
+static void
+remove_files (const char *dir, int first, int last)
+{
+  char name[32];
+  int i;
+
+  msg ("remove \"f%d\" to \"f%d\" from \"%s\"", first, last - 1, dir);
+  quiet = true;
+  for (i = first; i < last; i++)
+    {
+      snprintf (name, sizeof name, "%s/f%d", dir, i);
+      CHECK (remove (name), "remove \"%s\"", name);
+    }
+  quiet = false;
+}
+
+/* Reads the next name of the listing of DIR, open as FD, into SEEN.
+   Returns false at the end of the listing. */
+static bool
+list_one (int fd, const char *dir, bool seen[])
+{
+  char name[READDIR_MAX_LEN + 1];
+  int i;
+
+  if (!readdir (fd, name))
+    return false;
+  i = atoi (name + 1);
+  CHECK (name[0] == 'f' && i >= 0 && i < MAX_CNT,
+         "\"%s\" was created in \"%s\"", name, dir);
+  CHECK (!seen[i], "\"%s\" is listed once in \"%s\"", name, dir);
+  seen[i] = true;
+  return true;
+}
+
+/* Grows DIR from CNT files to GROW_CNT files and shrinks it by
+   removing the first DROP_CNT files, after the first name of a
+   listing and before the rest of it. */
+static void
+list_while_changing (const char *dir, int cnt, int grow_cnt, int drop_cnt)
+{
+  static bool seen[MAX_CNT];
+  char name[32];
+  bool listed;
+  int fd, i;
+
+  CHECK (mkdir (dir), "mkdir \"%s\"", dir);
+  create_files (dir, 0, cnt);
+
+  memset (seen, 0, sizeof seen);
+  CHECK ((fd = open (dir)) > 1, "open \"%s\"", dir);
+  quiet = true;
+  listed = list_one (fd, dir, seen);
+  quiet = false;
+  CHECK (listed, "read first name of \"%s\"", dir);
+  create_files (dir, cnt, grow_cnt);
+  remove_files (dir, 0, drop_cnt);
+
+  msg ("list the rest of \"%s\"", dir);
+  quiet = true;
+  while (list_one (fd, dir, seen))
+    continue;
+  for (i = drop_cnt; i < cnt; i++)
+    CHECK (seen[i], "\"f%d\" is listed in \"%s\"", i, dir);
+  quiet = false;
+
+  msg ("look up all files in \"%s\"", dir);
+  quiet = true;
+  for (i = 0; i < grow_cnt; i++)
+    {
+      snprintf (name, sizeof name, "%s/f%d", dir, i);
+      if (i >= drop_cnt)
+        {
+          int file_fd;
+          CHECK ((file_fd = open (name)) > 1, "open \"%s\"", name);
+          close (file_fd);
+        }
+      else
+        CHECK (open (name) == -1, "open \"%s\" (must fail)", name);
+    }
+  quiet = false;
+  msg ("close \"%s\"", dir);
+  close (fd);
+
+  /* A new listing returns exactly the files left */
+  memset (seen, 0, sizeof seen);
+  CHECK ((fd = open (dir)) > 1, "open \"%s\"", dir);
+  msg ("list \"%s\" again", dir);
+  quiet = true;
+  while (list_one (fd, dir, seen))
+    continue;
+  for (i = 0; i < grow_cnt; i++)
+    CHECK (seen[i] == (i >= drop_cnt), "\"f%d\" is listed in \"%s\" "
+           "only if it exists", i, dir);
+  quiet = false;
+  msg ("close \"%s\"", dir);
+  close (fd);
+}
+
+void
+test_main (void) 
+{
+  /* Linear, grows past the point where it would be hashed */
+  list_while_changing ("lin", 20, 40, 5);
+
+  /* Hashed with 64 slots, fills up and overflows */
+  list_while_changing ("hash", 30, 70, 20);
+}
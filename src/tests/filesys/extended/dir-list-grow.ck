@@ -0,0 +1,33 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(dir-list-grow) begin
+(dir-list-grow) mkdir "lin"
+(dir-list-grow) create "f0" to "f19" in "lin"
+(dir-list-grow) open "lin"
+(dir-list-grow) read first name of "lin"
+(dir-list-grow) create "f20" to "f39" in "lin"
+(dir-list-grow) remove "f0" to "f4" from "lin"
+(dir-list-grow) list the rest of "lin"
+(dir-list-grow) look up all files in "lin"
+(dir-list-grow) close "lin"
+(dir-list-grow) open "lin"
+(dir-list-grow) list "lin" again
+(dir-list-grow) close "lin"
+(dir-list-grow) mkdir "hash"
+(dir-list-grow) create "f0" to "f29" in "hash"
+(dir-list-grow) open "hash"
+(dir-list-grow) read first name of "hash"
+(dir-list-grow) create "f30" to "f69" in "hash"
+(dir-list-grow) remove "f0" to "f19" from "hash"
+(dir-list-grow) list the rest of "hash"
+(dir-list-grow) look up all files in "hash"
+(dir-list-grow) close "hash"
+(dir-list-grow) open "hash"
+(dir-list-grow) list "hash" again
+(dir-list-grow) close "hash"
+(dir-list-grow) end
+EOF
+pass;
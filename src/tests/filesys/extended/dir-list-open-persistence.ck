@@ -0,0 +1,9 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+my ($fs);
+$fs->{'d'}{"f$_"} = [chr (ord ('a') + $_ % 26) x (100 + $_ * 30)]
+  foreach 0...29;
+check_archive ($fs);
+pass;
@@ -0,0 +1,59 @@
+/* Lists a directory and opens and reads every file as it is
+   listed, the pattern that stat-ahead prefetches inodes for.  Every
+   file must have its own size and contents. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FILE_CNT 30
+
+static char buf[1024];
+
+/* Size of file "d/fI". */
+#define FILE_SIZE(I) (100 + (I) * 30)
+
+void
+test_main (void) 
+{
+  static bool seen[FILE_CNT];
+  char name[READDIR_MAX_LEN + 1], path[32];
+  int dir_fd, fd, i, listed = 0;
+
+  CHECK (mkdir ("d"), "mkdir \"d\"");
+  msg ("create %d files in \"d\"", FILE_CNT);
+  quiet = true;
+  for (i = 0; i < FILE_CNT; i++)
+    {
+      snprintf (path, sizeof path, "d/f%d", i);
+      memset (buf, 'a' + i % 26, FILE_SIZE (i));
+      CHECK (create (path, 0), "create \"%s\"", path);
+      CHECK ((fd = open (path)) > 1, "open \"%s\"", path);
+      CHECK (write (fd, buf, FILE_SIZE (i)) == FILE_SIZE (i),
+             "write \"%s\"", path);
+      close (fd);
+    }
+  quiet = false;
+
+  CHECK ((dir_fd = open ("d")) > 1, "open \"d\"");
+  msg ("read every file of \"d\" as it is listed");
+  quiet = true;
+  while (readdir (dir_fd, name))
+    {
+      i = atoi (name + 1);
+      CHECK (name[0] == 'f' && i >= 0 && i < FILE_CNT && !seen[i],
+             "\"%s\" was created and is listed once", name);
+      seen[i] = true;
+      snprintf (path, sizeof path, "d/%s", name);
+      memset (buf, 'a' + i % 26, FILE_SIZE (i));
+      check_file (path, buf, FILE_SIZE (i));
+      listed++;
+    }
+  quiet = false;
+  CHECK (listed == FILE_CNT, "listed %d files", FILE_CNT);
+  msg ("close \"d\"");
+  close (dir_fd);
+}
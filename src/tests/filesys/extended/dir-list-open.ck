@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(dir-list-open) begin
+(dir-list-open) mkdir "d"
+(dir-list-open) create 30 files in "d"
+(dir-list-open) open "d"
+(dir-list-open) read every file of "d" as it is listed
+(dir-list-open) listed 30 files
+(dir-list-open) close "d"
+(dir-list-open) end
+EOF
+pass;
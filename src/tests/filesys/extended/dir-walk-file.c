@@ -0,0 +1,40 @@
+/* Walks paths that run through a regular file, which must fail,
+   and paths through nested directories, which must work.  Checks
+   that the types reported for files and directories are right. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  int fd;
+
+  CHECK (create ("file", 0), "create \"file\"");
+  CHECK (mkdir ("dir"), "mkdir \"dir\"");
+  CHECK (mkdir ("dir/sub"), "mkdir \"dir/sub\"");
+  CHECK (create ("dir/sub/f", 0), "create \"dir/sub/f\"");
+
+  CHECK (open ("file/x") == -1, "open \"file/x\" (must fail)");
+  CHECK (!create ("file/x", 0), "create \"file/x\" (must fail)");
+  CHECK (!mkdir ("file/y"), "mkdir \"file/y\" (must fail)");
+  CHECK (!chdir ("file"), "chdir \"file\" (must fail)");
+  CHECK (open ("dir/sub/f/g") == -1, "open \"dir/sub/f/g\" (must fail)");
+
+  CHECK ((fd = open ("dir/sub/f")) > 1, "open \"dir/sub/f\"");
+  CHECK (!isdir (fd), "\"dir/sub/f\" is not a directory");
+  msg ("close \"dir/sub/f\"");
+  close (fd);
+  CHECK ((fd = open ("dir/sub")) > 1, "open \"dir/sub\"");
+  CHECK (isdir (fd), "\"dir/sub\" is a directory");
+  msg ("close \"dir/sub\"");
+  close (fd);
+
+  CHECK (chdir ("dir/sub"), "chdir \"dir/sub\"");
+  CHECK ((fd = open ("f")) > 1, "open \"f\"");
+  CHECK (!isdir (fd), "\"f\" is not a directory");
+  msg ("close \"f\"");
+  close (fd);
+  CHECK (open ("f/g") == -1, "open \"f/g\" (must fail)");
+}
@@ -0,0 +1,29 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(dir-walk-file) begin
+(dir-walk-file) create "file"
+(dir-walk-file) mkdir "dir"
+(dir-walk-file) mkdir "dir/sub"
+(dir-walk-file) create "dir/sub/f"
+(dir-walk-file) open "file/x" (must fail)
+(dir-walk-file) create "file/x" (must fail)
+(dir-walk-file) mkdir "file/y" (must fail)
+(dir-walk-file) chdir "file" (must fail)
+(dir-walk-file) open "dir/sub/f/g" (must fail)
+(dir-walk-file) open "dir/sub/f"
+(dir-walk-file) "dir/sub/f" is not a directory
+(dir-walk-file) close "dir/sub/f"
+(dir-walk-file) open "dir/sub"
+(dir-walk-file) "dir/sub" is a directory
+(dir-walk-file) close "dir/sub"
+(dir-walk-file) chdir "dir/sub"
+(dir-walk-file) open "f"
+(dir-walk-file) "f" is not a directory
+(dir-walk-file) close "f"
+(dir-walk-file) open "f/g" (must fail)
+(dir-walk-file) end
+EOF
+pass;
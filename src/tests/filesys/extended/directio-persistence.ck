@@ -0,0 +1,10 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+my ($data) = join ('', map (chr (ord ('a') + $_ % 26), 0...8191));
+substr ($data, 1000, 700) = 'D' x 700;
+substr ($data, 4096, 512) = 'C' x 512;
+substr ($data, 6000, 100) = 'c' x 100;
+check_archive ({"d" => [$data], "dir" => {}});
+pass;
@@ -0,0 +1,77 @@
+/* Writes and reads a file through a handle with direct I/O enabled
+   and through a plain one, in whole and partial sectors, and checks
+   that each handle sees what the other wrote.  Direct I/O cannot be
+   enabled on a directory. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FILE_SIZE 8192
+
+static char buf[FILE_SIZE];
+static char rbuf[FILE_SIZE];
+
+/* Reads CNT bytes at OFS through FD, which is open as "d" in MODE,
+   and compares them to BUF. */
+static void
+read_at (int fd, const char *mode, size_t ofs, size_t cnt)
+{
+  msg ("seek \"d\" to %zu %s", ofs, mode);
+  seek (fd, ofs);
+  CHECK (read (fd, rbuf, cnt) == (int) cnt, "read %zu bytes %s", cnt, mode);
+  compare_bytes (rbuf, buf + ofs, cnt, ofs, "d");
+}
+
+/* Writes the CNT bytes at OFS of BUF through FD, which is open as
+   "d" in MODE. */
+static void
+write_at (int fd, const char *mode, size_t ofs, size_t cnt)
+{
+  msg ("seek \"d\" to %zu %s", ofs, mode);
+  seek (fd, ofs);
+  CHECK (write (fd, buf + ofs, cnt) == (int) cnt, "write %zu bytes %s",
+         cnt, mode);
+}
+
+void
+test_main (void) 
+{
+  int direct_fd, cached_fd, dir_fd;
+  size_t i;
+
+  for (i = 0; i < FILE_SIZE; i++)
+    buf[i] = 'a' + i % 26;
+  CHECK (create ("d", 0), "create \"d\"");
+  CHECK ((direct_fd = open ("d")) > 1, "open \"d\"");
+  CHECK (directio (direct_fd, true), "enable direct I/O on \"d\"");
+  CHECK ((cached_fd = open ("d")) > 1, "open \"d\" again");
+
+  /* Direct writes, whole and partial sectors, read through the cache */
+  write_at (direct_fd, "directly", 0, FILE_SIZE);
+  read_at (cached_fd, "through the cache", 0, FILE_SIZE);
+  memset (buf + 1000, 'D', 700);
+  write_at (direct_fd, "directly", 1000, 700);
+  read_at (cached_fd, "through the cache", 512, 2048);
+
+  /* Cached writes read directly */
+  memset (buf + 4096, 'C', 512);
+  write_at (cached_fd, "through the cache", 4096, 512);
+  memset (buf + 6000, 'c', 100);
+  write_at (cached_fd, "through the cache", 6000, 100);
+  read_at (direct_fd, "directly", 0, FILE_SIZE);
+
+  msg ("close \"d\"");
+  close (direct_fd);
+  msg ("close \"d\"");
+  close (cached_fd);
+  check_file ("d", buf, FILE_SIZE);
+
+  CHECK (mkdir ("dir"), "mkdir \"dir\"");
+  CHECK ((dir_fd = open ("dir")) > 1, "open \"dir\"");
+  CHECK (!directio (dir_fd, true),
+         "enable direct I/O on \"dir\" (must fail)");
+  msg ("close \"dir\"");
+  close (dir_fd);
+}
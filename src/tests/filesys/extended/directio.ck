@@ -0,0 +1,36 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(directio) begin
+(directio) create "d"
+(directio) open "d"
+(directio) enable direct I/O on "d"
+(directio) open "d" again
+(directio) seek "d" to 0 directly
+(directio) write 8192 bytes directly
+(directio) seek "d" to 0 through the cache
+(directio) read 8192 bytes through the cache
+(directio) seek "d" to 1000 directly
+(directio) write 700 bytes directly
+(directio) seek "d" to 512 through the cache
+(directio) read 2048 bytes through the cache
+(directio) seek "d" to 4096 through the cache
+(directio) write 512 bytes through the cache
+(directio) seek "d" to 6000 through the cache
+(directio) write 100 bytes through the cache
+(directio) seek "d" to 0 directly
+(directio) read 8192 bytes directly
+(directio) close "d"
+(directio) close "d"
+(directio) open "d" for verification
+(directio) verified contents of "d"
+(directio) close "d"
+(directio) mkdir "dir"
+(directio) open "dir"
+(directio) enable direct I/O on "dir" (must fail)
+(directio) close "dir"
+(directio) end
+EOF
+pass;
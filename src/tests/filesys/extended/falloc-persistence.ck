@@ -0,0 +1,6 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_archive ({"falloc" => ["\0" x 5000 . 'f' x 1000 . "\0" x 4000]});
+pass;
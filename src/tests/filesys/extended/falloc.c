@@ -0,0 +1,48 @@
+/* Preallocates space for a file with fallocate() and checks that
+   the file grows to cover it and reads as zeros, that the space can
+   be written, and that a request larger than the disk fails without
+   changing the size of the file. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static char buf[10000];
+
+void
+test_main (void) 
+{
+  const char *file_name = "falloc";
+  const char *big_name = "big";
+  int fd, big_fd;
+
+  CHECK (create (file_name, 0), "create \"%s\"", file_name);
+  CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+  CHECK (fallocate (fd, 0, sizeof buf),
+         "fallocate %zu bytes in \"%s\"", sizeof buf, file_name);
+  CHECK (filesize (fd) == sizeof buf, "\"%s\" has %zu bytes",
+         file_name, sizeof buf);
+  CHECK (fallocate (fd, 0, 100), "fallocate 100 bytes in \"%s\"", file_name);
+  CHECK (filesize (fd) == sizeof buf, "\"%s\" still has %zu bytes",
+         file_name, sizeof buf);
+  check_file_handle (fd, file_name, buf, sizeof buf);
+
+  memset (buf + 5000, 'f', 1000);
+  msg ("seek \"%s\"", file_name);
+  seek (fd, 5000);
+  CHECK (write (fd, buf + 5000, 1000) == 1000, "write \"%s\"", file_name);
+  msg ("close \"%s\"", file_name);
+  close (fd);
+  check_file (file_name, buf, sizeof buf);
+
+  /* More than the disk holds */
+  CHECK (create (big_name, 0), "create \"%s\"", big_name);
+  CHECK ((big_fd = open (big_name)) > 1, "open \"%s\"", big_name);
+  CHECK (!fallocate (big_fd, 0, 4 * 1024 * 1024),
+         "fallocate 4 MB in \"%s\" (must fail)", big_name);
+  CHECK (filesize (big_fd) == 0, "\"%s\" is still empty", big_name);
+  msg ("close \"%s\"", big_name);
+  close (big_fd);
+  CHECK (remove (big_name), "remove \"%s\"", big_name);
+}
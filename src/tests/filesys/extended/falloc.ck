@@ -0,0 +1,28 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(falloc) begin
+(falloc) create "falloc"
+(falloc) open "falloc"
+(falloc) fallocate 10000 bytes in "falloc"
+(falloc) "falloc" has 10000 bytes
+(falloc) fallocate 100 bytes in "falloc"
+(falloc) "falloc" still has 10000 bytes
+(falloc) verified contents of "falloc"
+(falloc) seek "falloc"
+(falloc) write "falloc"
+(falloc) close "falloc"
+(falloc) open "falloc" for verification
+(falloc) verified contents of "falloc"
+(falloc) close "falloc"
+(falloc) create "big"
+(falloc) open "big"
+(falloc) fallocate 4 MB in "big" (must fail)
+(falloc) "big" is still empty
+(falloc) close "big"
+(falloc) remove "big"
+(falloc) end
+EOF
+pass;
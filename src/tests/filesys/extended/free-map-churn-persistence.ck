@@ -0,0 +1,9 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+my ($fs);
+$fs->{"old$_"} = [chr (ord ('a') + $_) x 2048] foreach grep ($_ % 2 == 0, 0...19);
+$fs->{"new$_"} = [chr (ord ('A') + $_) x 3072] foreach 0...9;
+check_archive ($fs);
+pass;
@@ -0,0 +1,64 @@
+/* Creates a run of files, removes every other one and creates new,
+   larger files in the gaps.  The persistence check then catches
+   sectors that were used when the disk was unmounted but were not
+   marked used in the free map on disk. */
+
+#include <stdio.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FILE_CNT 20
+
+static char buf[3072];
+
+/* Creates file NAME holding SIZE bytes of C. */
+static void
+make_file (const char *name, char c, size_t size)
+{
+  int fd;
+
+  memset (buf, c, size);
+  CHECK (create (name, 0), "create \"%s\"", name);
+  CHECK ((fd = open (name)) > 1, "open \"%s\"", name);
+  CHECK (write (fd, buf, size) == (int) size, "write \"%s\"", name);
+  msg ("close \"%s\"", name);
+  close (fd);
+}
+
+void
+test_main (void) 
+{
+  char name[16];
+  int i;
+
+  for (i = 0; i < FILE_CNT; i++)
+    {
+      snprintf (name, sizeof name, "old%d", i);
+      make_file (name, 'a' + i, 2048);
+    }
+  for (i = 1; i < FILE_CNT; i += 2)
+    {
+      snprintf (name, sizeof name, "old%d", i);
+      CHECK (remove (name), "remove \"%s\"", name);
+    }
+  for (i = 0; i < FILE_CNT / 2; i++)
+    {
+      snprintf (name, sizeof name, "new%d", i);
+      make_file (name, 'A' + i, 3072);
+    }
+
+  for (i = 0; i < FILE_CNT; i += 2)
+    {
+      snprintf (name, sizeof name, "old%d", i);
+      memset (buf, 'a' + i, 2048);
+      check_file (name, buf, 2048);
+    }
+  for (i = 0; i < FILE_CNT / 2; i++)
+    {
+      snprintf (name, sizeof name, "new%d", i);
+      memset (buf, 'A' + i, 3072);
+      check_file (name, buf, 3072);
+    }
+}
@@ -0,0 +1,199 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(free-map-churn) begin
+(free-map-churn) create "old0"
+(free-map-churn) open "old0"
+(free-map-churn) write "old0"
+(free-map-churn) close "old0"
+(free-map-churn) create "old1"
+(free-map-churn) open "old1"
+(free-map-churn) write "old1"
+(free-map-churn) close "old1"
+(free-map-churn) create "old2"
+(free-map-churn) open "old2"
+(free-map-churn) write "old2"
+(free-map-churn) close "old2"
+(free-map-churn) create "old3"
+(free-map-churn) open "old3"
+(free-map-churn) write "old3"
+(free-map-churn) close "old3"
+(free-map-churn) create "old4"
+(free-map-churn) open "old4"
+(free-map-churn) write "old4"
+(free-map-churn) close "old4"
+(free-map-churn) create "old5"
+(free-map-churn) open "old5"
+(free-map-churn) write "old5"
+(free-map-churn) close "old5"
+(free-map-churn) create "old6"
+(free-map-churn) open "old6"
+(free-map-churn) write "old6"
+(free-map-churn) close "old6"
+(free-map-churn) create "old7"
+(free-map-churn) open "old7"
+(free-map-churn) write "old7"
+(free-map-churn) close "old7"
+(free-map-churn) create "old8"
+(free-map-churn) open "old8"
+(free-map-churn) write "old8"
+(free-map-churn) close "old8"
+(free-map-churn) create "old9"
+(free-map-churn) open "old9"
+(free-map-churn) write "old9"
+(free-map-churn) close "old9"
+(free-map-churn) create "old10"
+(free-map-churn) open "old10"
+(free-map-churn) write "old10"
+(free-map-churn) close "old10"
+(free-map-churn) create "old11"
+(free-map-churn) open "old11"
+(free-map-churn) write "old11"
+(free-map-churn) close "old11"
+(free-map-churn) create "old12"
+(free-map-churn) open "old12"
+(free-map-churn) write "old12"
+(free-map-churn) close "old12"
+(free-map-churn) create "old13"
+(free-map-churn) open "old13"
+(free-map-churn) write "old13"
+(free-map-churn) close "old13"
+(free-map-churn) create "old14"
+(free-map-churn) open "old14"
+(free-map-churn) write "old14"
+(free-map-churn) close "old14"
+(free-map-churn) create "old15"
+(free-map-churn) open "old15"
+(free-map-churn) write "old15"
+(free-map-churn) close "old15"
+(free-map-churn) create "old16"
+(free-map-churn) open "old16"
+(free-map-churn) write "old16"
+(free-map-churn) close "old16"
+(free-map-churn) create "old17"
+(free-map-churn) open "old17"
+(free-map-churn) write "old17"
+(free-map-churn) close "old17"
+(free-map-churn) create "old18"
+(free-map-churn) open "old18"
+(free-map-churn) write "old18"
+(free-map-churn) close "old18"
+(free-map-churn) create "old19"
+(free-map-churn) open "old19"
+(free-map-churn) write "old19"
+(free-map-churn) close "old19"
+(free-map-churn) remove "old1"
+(free-map-churn) remove "old3"
+(free-map-churn) remove "old5"
+(free-map-churn) remove "old7"
+(free-map-churn) remove "old9"
+(free-map-churn) remove "old11"
+(free-map-churn) remove "old13"
+(free-map-churn) remove "old15"
+(free-map-churn) remove "old17"
+(free-map-churn) remove "old19"
+(free-map-churn) create "new0"
+(free-map-churn) open "new0"
+(free-map-churn) write "new0"
+(free-map-churn) close "new0"
+(free-map-churn) create "new1"
+(free-map-churn) open "new1"
+(free-map-churn) write "new1"
+(free-map-churn) close "new1"
+(free-map-churn) create "new2"
+(free-map-churn) open "new2"
+(free-map-churn) write "new2"
+(free-map-churn) close "new2"
+(free-map-churn) create "new3"
+(free-map-churn) open "new3"
+(free-map-churn) write "new3"
+(free-map-churn) close "new3"
+(free-map-churn) create "new4"
+(free-map-churn) open "new4"
+(free-map-churn) write "new4"
+(free-map-churn) close "new4"
+(free-map-churn) create "new5"
+(free-map-churn) open "new5"
+(free-map-churn) write "new5"
+(free-map-churn) close "new5"
+(free-map-churn) create "new6"
+(free-map-churn) open "new6"
+(free-map-churn) write "new6"
+(free-map-churn) close "new6"
+(free-map-churn) create "new7"
+(free-map-churn) open "new7"
+(free-map-churn) write "new7"
+(free-map-churn) close "new7"
+(free-map-churn) create "new8"
+(free-map-churn) open "new8"
+(free-map-churn) write "new8"
+(free-map-churn) close "new8"
+(free-map-churn) create "new9"
+(free-map-churn) open "new9"
+(free-map-churn) write "new9"
+(free-map-churn) close "new9"
+(free-map-churn) open "old0" for verification
+(free-map-churn) verified contents of "old0"
+(free-map-churn) close "old0"
+(free-map-churn) open "old2" for verification
+(free-map-churn) verified contents of "old2"
+(free-map-churn) close "old2"
+(free-map-churn) open "old4" for verification
+(free-map-churn) verified contents of "old4"
+(free-map-churn) close "old4"
+(free-map-churn) open "old6" for verification
+(free-map-churn) verified contents of "old6"
+(free-map-churn) close "old6"
+(free-map-churn) open "old8" for verification
+(free-map-churn) verified contents of "old8"
+(free-map-churn) close "old8"
+(free-map-churn) open "old10" for verification
+(free-map-churn) verified contents of "old10"
+(free-map-churn) close "old10"
+(free-map-churn) open "old12" for verification
+(free-map-churn) verified contents of "old12"
+(free-map-churn) close "old12"
+(free-map-churn) open "old14" for verification
+(free-map-churn) verified contents of "old14"
+(free-map-churn) close "old14"
+(free-map-churn) open "old16" for verification
+(free-map-churn) verified contents of "old16"
+(free-map-churn) close "old16"
+(free-map-churn) open "old18" for verification
+(free-map-churn) verified contents of "old18"
+(free-map-churn) close "old18"
+(free-map-churn) open "new0" for verification
+(free-map-churn) verified contents of "new0"
+(free-map-churn) close "new0"
+(free-map-churn) open "new1" for verification
+(free-map-churn) verified contents of "new1"
+(free-map-churn) close "new1"
+(free-map-churn) open "new2" for verification
+(free-map-churn) verified contents of "new2"
+(free-map-churn) close "new2"
+(free-map-churn) open "new3" for verification
+(free-map-churn) verified contents of "new3"
+(free-map-churn) close "new3"
+(free-map-churn) open "new4" for verification
+(free-map-churn) verified contents of "new4"
+(free-map-churn) close "new4"
+(free-map-churn) open "new5" for verification
+(free-map-churn) verified contents of "new5"
+(free-map-churn) close "new5"
+(free-map-churn) open "new6" for verification
+(free-map-churn) verified contents of "new6"
+(free-map-churn) close "new6"
+(free-map-churn) open "new7" for verification
+(free-map-churn) verified contents of "new7"
+(free-map-churn) close "new7"
+(free-map-churn) open "new8" for verification
+(free-map-churn) verified contents of "new8"
+(free-map-churn) close "new8"
+(free-map-churn) open "new9" for verification
+(free-map-churn) verified contents of "new9"
+(free-map-churn) close "new9"
+(free-map-churn) end
+EOF
+pass;
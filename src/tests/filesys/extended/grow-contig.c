@@ -0,0 +1,30 @@
+/* Writes a file with a single large write and checks that its data
+   sectors were allocated as one run of consecutive sectors. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static char buf[40960];
+
+void
+test_main (void) 
+{
+  const char *file_name = "contig";
+  struct defrag_stats stats;
+  int fd;
+
+  memset (buf, 'c', sizeof buf);
+  CHECK (create (file_name, 0), "create \"%s\"", file_name);
+  CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+  CHECK (write (fd, buf, sizeof buf) == (int) sizeof buf,
+         "write \"%s\"", file_name);
+  CHECK (defrag (fd, &stats), "get layout of \"%s\"", file_name);
+  CHECK (stats.sectors == sizeof buf / 512,
+         "\"%s\" has %zu data sectors", file_name, sizeof buf / 512);
+  CHECK (stats.extents_before == 1, "\"%s\" was one extent", file_name);
+  msg ("close \"%s\"", file_name);
+  close (fd);
+  check_file (file_name, buf, sizeof buf);
+}
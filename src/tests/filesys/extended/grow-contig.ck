@@ -0,0 +1,19 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(grow-contig) begin
+(grow-contig) create "contig"
+(grow-contig) open "contig"
+(grow-contig) write "contig"
+(grow-contig) get layout of "contig"
+(grow-contig) "contig" has 80 data sectors
+(grow-contig) "contig" was one extent
+(grow-contig) close "contig"
+(grow-contig) open "contig" for verification
+(grow-contig) verified contents of "contig"
+(grow-contig) close "contig"
+(grow-contig) end
+EOF
+pass;
@@ -0,0 +1,64 @@
+/* Writes one sector at the start of a file and one past 8 MB, so
+   that the index tree of the file has to grow by two levels over
+   the entry it already holds.  Checks both sectors and the hole in
+   between, then removes the file and checks that its sectors can
+   be used again. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FAR_OFS (9 * 1024 * 1024)
+
+static char buf[512];
+static char zeros[512];
+static char first[512], last[512], small[4096];
+
+/* Reads the sector at OFS of FD and compares it to EXPECTED. */
+static void
+check_sector (int fd, unsigned ofs, const char *expected)
+{
+  msg ("seek \"huge\" to %u", ofs);
+  seek (fd, ofs);
+  CHECK (read (fd, buf, sizeof buf) == (int) sizeof buf,
+         "read \"huge\" at %u", ofs);
+  compare_bytes (buf, expected, sizeof buf, ofs, "huge");
+}
+
+void
+test_main (void) 
+{
+  int fd;
+
+  memset (first, 'a', sizeof first);
+  memset (last, 'z', sizeof last);
+  CHECK (create ("huge", 0), "create \"huge\"");
+  CHECK ((fd = open ("huge")) > 1, "open \"huge\"");
+  CHECK (write (fd, first, sizeof first) == (int) sizeof first,
+         "write first sector of \"huge\"");
+  msg ("seek \"huge\" past 8 MB");
+  seek (fd, FAR_OFS);
+  CHECK (write (fd, last, sizeof last) == (int) sizeof last,
+         "write sector past 8 MB in \"huge\"");
+  CHECK (filesize (fd) == FAR_OFS + 512, "\"huge\" has %d bytes",
+         FAR_OFS + 512);
+
+  check_sector (fd, 0, first);
+  check_sector (fd, 4 * 1024 * 1024, zeros);
+  check_sector (fd, FAR_OFS, last);
+  CHECK (seek_data (fd, 512, SEEK_DATA) == FAR_OFS,
+         "data from 512 at %d", FAR_OFS);
+  msg ("close \"huge\"");
+  close (fd);
+  CHECK (remove ("huge"), "remove \"huge\"");
+
+  memset (small, 's', sizeof small);
+  CHECK (create ("small", 0), "create \"small\"");
+  CHECK ((fd = open ("small")) > 1, "open \"small\"");
+  CHECK (write (fd, small, sizeof small) == (int) sizeof small,
+         "write \"small\"");
+  msg ("close \"small\"");
+  close (fd);
+  check_file ("small", small, sizeof small);
+}
@@ -0,0 +1,31 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(grow-huge) begin
+(grow-huge) create "huge"
+(grow-huge) open "huge"
+(grow-huge) write first sector of "huge"
+(grow-huge) seek "huge" past 8 MB
+(grow-huge) write sector past 8 MB in "huge"
+(grow-huge) "huge" has 9437696 bytes
+(grow-huge) seek "huge" to 0
+(grow-huge) read "huge" at 0
+(grow-huge) seek "huge" to 4194304
+(grow-huge) read "huge" at 4194304
+(grow-huge) seek "huge" to 9437184
+(grow-huge) read "huge" at 9437184
+(grow-huge) data from 512 at 9437184
+(grow-huge) close "huge"
+(grow-huge) remove "huge"
+(grow-huge) create "small"
+(grow-huge) open "small"
+(grow-huge) write "small"
+(grow-huge) close "small"
+(grow-huge) open "small" for verification
+(grow-huge) verified contents of "small"
+(grow-huge) close "small"
+(grow-huge) end
+EOF
+pass;
@@ -0,0 +1,6 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_archive ({"a" => ['a' x 32768], "b" => ['b' x 32768]});
+pass;
@@ -0,0 +1,61 @@
+/* Grows two files in turns, one sector at a time, and checks that
+   the data of each file still ends up in a few long runs instead of
+   alternating with the sectors of the other file. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FILE_SIZE 32768
+#define MAX_EXTENTS 4
+
+static char buf_a[FILE_SIZE];
+static char buf_b[FILE_SIZE];
+
+/* Checks the layout of FILE_NAME, open as FD. */
+static void
+check_layout (int fd, const char *file_name)
+{
+  struct defrag_stats stats;
+
+  CHECK (defrag (fd, &stats), "get layout of \"%s\"", file_name);
+  CHECK (stats.sectors == FILE_SIZE / 512,
+         "\"%s\" has %d data sectors", file_name, FILE_SIZE / 512);
+  CHECK (stats.extents_before <= MAX_EXTENTS,
+         "\"%s\" was at most %d extents", file_name, MAX_EXTENTS);
+}
+
+void
+test_main (void) 
+{
+  size_t ofs;
+  int fd_a, fd_b;
+
+  memset (buf_a, 'a', sizeof buf_a);
+  memset (buf_b, 'b', sizeof buf_b);
+  CHECK (create ("a", 0), "create \"a\"");
+  CHECK (create ("b", 0), "create \"b\"");
+  CHECK ((fd_a = open ("a")) > 1, "open \"a\"");
+  CHECK ((fd_b = open ("b")) > 1, "open \"b\"");
+
+  msg ("write \"a\" and \"b\" alternately");
+  quiet = true;
+  for (ofs = 0; ofs < FILE_SIZE; ofs += 512)
+    {
+      CHECK (write (fd_a, buf_a + ofs, 512) == 512,
+             "write 512 bytes at offset %zu in \"a\"", ofs);
+      CHECK (write (fd_b, buf_b + ofs, 512) == 512,
+             "write 512 bytes at offset %zu in \"b\"", ofs);
+    }
+  quiet = false;
+
+  check_layout (fd_a, "a");
+  check_layout (fd_b, "b");
+  msg ("close \"a\"");
+  close (fd_a);
+  msg ("close \"b\"");
+  close (fd_b);
+  check_file ("a", buf_a, sizeof buf_a);
+  check_file ("b", buf_b, sizeof buf_b);
+}
@@ -0,0 +1,50 @@
+/* Creates, writes and removes a 1 MB file over and over.  Two of
+   them do not fit on the disk together, so each round needs the
+   sectors of the file removed in the round before. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FILE_SIZE (1024 * 1024)
+#define ROUND_CNT 4
+
+static char buf[4096];
+
+void
+test_main (void) 
+{
+  const char *file_name = "big";
+  int round, fd;
+
+  for (round = 0; round < ROUND_CNT; round++)
+    {
+      size_t ofs;
+
+      msg ("round %d", round);
+      memset (buf, 'a' + round, sizeof buf);
+      CHECK (create (file_name, 0), "create \"%s\"", file_name);
+      CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+      quiet = true;
+      for (ofs = 0; ofs < FILE_SIZE; ofs += sizeof buf)
+        CHECK (write (fd, buf, sizeof buf) == (int) sizeof buf,
+               "write %zu bytes at offset %zu in \"%s\"",
+               sizeof buf, ofs, file_name);
+      quiet = false;
+      CHECK (filesize (fd) == FILE_SIZE, "\"%s\" has %d bytes",
+             file_name, FILE_SIZE);
+      msg ("close \"%s\"", file_name);
+      close (fd);
+      CHECK (remove (file_name), "remove \"%s\"", file_name);
+    }
+
+  /* The free map must be intact for the files written after */
+  memset (buf, 'z', sizeof buf);
+  CHECK (create ("small", 0), "create \"small\"");
+  CHECK ((fd = open ("small")) > 1, "open \"small\"");
+  CHECK (write (fd, buf, sizeof buf) == (int) sizeof buf, "write \"small\"");
+  msg ("close \"small\"");
+  close (fd);
+  check_file ("small", buf, sizeof buf);
+}
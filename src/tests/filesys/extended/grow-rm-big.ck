@@ -0,0 +1,40 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(grow-rm-big) begin
+(grow-rm-big) round 0
+(grow-rm-big) create "big"
+(grow-rm-big) open "big"
+(grow-rm-big) "big" has 1048576 bytes
+(grow-rm-big) close "big"
+(grow-rm-big) remove "big"
+(grow-rm-big) round 1
+(grow-rm-big) create "big"
+(grow-rm-big) open "big"
+(grow-rm-big) "big" has 1048576 bytes
+(grow-rm-big) close "big"
+(grow-rm-big) remove "big"
+(grow-rm-big) round 2
+(grow-rm-big) create "big"
+(grow-rm-big) open "big"
+(grow-rm-big) "big" has 1048576 bytes
+(grow-rm-big) close "big"
+(grow-rm-big) remove "big"
+(grow-rm-big) round 3
+(grow-rm-big) create "big"
+(grow-rm-big) open "big"
+(grow-rm-big) "big" has 1048576 bytes
+(grow-rm-big) close "big"
+(grow-rm-big) remove "big"
+(grow-rm-big) create "small"
+(grow-rm-big) open "small"
+(grow-rm-big) write "small"
+(grow-rm-big) close "small"
+(grow-rm-big) open "small" for verification
+(grow-rm-big) verified contents of "small"
+(grow-rm-big) close "small"
+(grow-rm-big) end
+EOF
+pass;
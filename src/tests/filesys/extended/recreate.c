@@ -0,0 +1,58 @@
+/* Removes and recreates a file under the same name over and over,
+   with a different size each time, so the new inode often lands in
+   the sector of the old one while it is still retained in memory.
+   Every round must see the new size and contents.  Also checks that
+   a handle kept open across the removal still reads the old
+   file. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define ROUND_CNT 8
+
+static char buf[2048];
+static char old_buf[2048];
+
+/* Creates "a" with SIZE bytes of C. */
+static void
+make_file (char c, size_t size)
+{
+  int fd;
+
+  memset (buf, c, size);
+  CHECK (create ("a", 0), "create \"a\"");
+  CHECK ((fd = open ("a")) > 1, "open \"a\"");
+  CHECK (write (fd, buf, size) == (int) size, "write %zu bytes to \"a\"",
+         size);
+  msg ("close \"a\"");
+  close (fd);
+}
+
+void
+test_main (void) 
+{
+  size_t size = 0;
+  int round, fd;
+
+  for (round = 0; round < ROUND_CNT; round++)
+    {
+      size = 2048 - round * 250;
+      make_file ('a' + round, size);
+      check_file ("a", buf, size);
+      CHECK (remove ("a"), "remove \"a\"");
+    }
+
+  /* An open handle keeps the removed file */
+  make_file ('x', 1000);
+  memcpy (old_buf, buf, 1000);
+  CHECK ((fd = open ("a")) > 1, "open \"a\"");
+  CHECK (remove ("a"), "remove \"a\"");
+  make_file ('y', 500);
+  check_file ("a", buf, 500);
+  check_file_handle (fd, "a", old_buf, 1000);
+  msg ("close \"a\"");
+  close (fd);
+  check_file ("a", buf, 500);
+}
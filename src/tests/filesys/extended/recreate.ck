@@ -0,0 +1,91 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(recreate) begin
+(recreate) create "a"
+(recreate) open "a"
+(recreate) write 2048 bytes to "a"
+(recreate) close "a"
+(recreate) open "a" for verification
+(recreate) verified contents of "a"
+(recreate) close "a"
+(recreate) remove "a"
+(recreate) create "a"
+(recreate) open "a"
+(recreate) write 1798 bytes to "a"
+(recreate) close "a"
+(recreate) open "a" for verification
+(recreate) verified contents of "a"
+(recreate) close "a"
+(recreate) remove "a"
+(recreate) create "a"
+(recreate) open "a"
+(recreate) write 1548 bytes to "a"
+(recreate) close "a"
+(recreate) open "a" for verification
+(recreate) verified contents of "a"
+(recreate) close "a"
+(recreate) remove "a"
+(recreate) create "a"
+(recreate) open "a"
+(recreate) write 1298 bytes to "a"
+(recreate) close "a"
+(recreate) open "a" for verification
+(recreate) verified contents of "a"
+(recreate) close "a"
+(recreate) remove "a"
+(recreate) create "a"
+(recreate) open "a"
+(recreate) write 1048 bytes to "a"
+(recreate) close "a"
+(recreate) open "a" for verification
+(recreate) verified contents of "a"
+(recreate) close "a"
+(recreate) remove "a"
+(recreate) create "a"
+(recreate) open "a"
+(recreate) write 798 bytes to "a"
+(recreate) close "a"
+(recreate) open "a" for verification
+(recreate) verified contents of "a"
+(recreate) close "a"
+(recreate) remove "a"
+(recreate) create "a"
+(recreate) open "a"
+(recreate) write 548 bytes to "a"
+(recreate) close "a"
+(recreate) open "a" for verification
+(recreate) verified contents of "a"
+(recreate) close "a"
+(recreate) remove "a"
+(recreate) create "a"
+(recreate) open "a"
+(recreate) write 298 bytes to "a"
+(recreate) close "a"
+(recreate) open "a" for verification
+(recreate) verified contents of "a"
+(recreate) close "a"
+(recreate) remove "a"
+(recreate) create "a"
+(recreate) open "a"
+(recreate) write 1000 bytes to "a"
+(recreate) close "a"
+(recreate) open "a"
+(recreate) remove "a"
+(recreate) create "a"
+(recreate) open "a"
+(recreate) write 500 bytes to "a"
+(recreate) close "a"
+(recreate) open "a" for verification
+(recreate) verified contents of "a"
+(recreate) close "a"
+(recreate) verified contents of "a"
+(recreate) close "a"
+(recreate) open "a" for verification
+(recreate) verified contents of "a"
+(recreate) close "a"
+(recreate) end
+EOF
+pass;
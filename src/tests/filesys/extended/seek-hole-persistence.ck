@@ -0,0 +1,6 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_archive ({"sparse" => ['d' x 512 . "\0" x 19968 . 'e' x 512]});
+pass;
@@ -0,0 +1,41 @@
+/* Writes the first and the last sector of a file, leaving a hole in
+   between, and checks what seek_data() finds from several offsets. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static char buf[20992];
+
+void
+test_main (void) 
+{
+  const char *file_name = "sparse";
+  int fd;
+
+  memset (buf, 'd', 512);
+  memset (buf + 20480, 'e', 512);
+  CHECK (create (file_name, 0), "create \"%s\"", file_name);
+  CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+  CHECK (write (fd, buf, 512) == 512, "write first sector of \"%s\"",
+         file_name);
+  msg ("seek \"%s\"", file_name);
+  seek (fd, 20480);
+  CHECK (write (fd, buf + 20480, 512) == 512, "write last sector of \"%s\"",
+         file_name);
+
+  CHECK (seek_data (fd, 0, SEEK_DATA) == 0, "data at 0");
+  CHECK (seek_data (fd, 0, SEEK_HOLE) == 512, "hole from 0 at 512");
+  CHECK (seek_data (fd, 600, SEEK_HOLE) == 600, "hole from 600 at 600");
+  CHECK (seek_data (fd, 512, SEEK_DATA) == 20480,
+         "data from 512 at 20480");
+  CHECK (seek_data (fd, 20480, SEEK_HOLE) == 20992,
+         "hole from 20480 at the end of the file");
+  CHECK (seek_data (fd, 20992, SEEK_DATA) == -1,
+         "no data from the end of the file");
+  CHECK (tell (fd) == 20992, "position in \"%s\" is unchanged", file_name);
+  msg ("close \"%s\"", file_name);
+  close (fd);
+  check_file (file_name, buf, sizeof buf);
+}
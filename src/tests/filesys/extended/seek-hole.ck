@@ -0,0 +1,25 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(seek-hole) begin
+(seek-hole) create "sparse"
+(seek-hole) open "sparse"
+(seek-hole) write first sector of "sparse"
+(seek-hole) seek "sparse"
+(seek-hole) write last sector of "sparse"
+(seek-hole) data at 0
+(seek-hole) hole from 0 at 512
+(seek-hole) hole from 600 at 600
+(seek-hole) data from 512 at 20480
+(seek-hole) hole from 20480 at the end of the file
+(seek-hole) no data from the end of the file
+(seek-hole) position in "sparse" is unchanged
+(seek-hole) close "sparse"
+(seek-hole) open "sparse" for verification
+(seek-hole) verified contents of "sparse"
+(seek-hole) close "sparse"
+(seek-hole) end
+EOF
+pass;
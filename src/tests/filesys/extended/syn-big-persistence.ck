@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+my ($fs);
+$fs->{'child-syn-big'} = "tests/filesys/extended/child-syn-big";
+for my $child (0...2) {
+    $fs->{"big$child"}
+      = [join ('', map (chr (ord ('a') + ($child * 7 + $_) % 26) x 1000,
+			0...63))];
+}
+check_archive ($fs);
+pass;
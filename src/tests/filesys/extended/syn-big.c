@@ -0,0 +1,39 @@
+/* Subprocesses write a file each at the same time, much more data
+   than the buffer cache holds, so that writers have to write back
+   their own dirty sectors as they go.  Checks every file once they
+   are done. */
+
+#include <stdio.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/filesys/extended/syn-big.h"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static char buf[FILE_SIZE];
+
+void
+test_main (void) 
+{
+  pid_t children[CHILD_CNT];
+  char name[16];
+  int child, chunk;
+
+  for (child = 0; child < CHILD_CNT; child++)
+    {
+      snprintf (name, sizeof name, "big%d", child);
+      CHECK (create (name, 0), "create \"%s\"", name);
+    }
+
+  exec_children ("child-syn-big", children, CHILD_CNT);
+  wait_children (children, CHILD_CNT);
+
+  for (child = 0; child < CHILD_CNT; child++)
+    {
+      snprintf (name, sizeof name, "big%d", child);
+      for (chunk = 0; chunk < CHUNK_CNT; chunk++)
+        memset (buf + chunk * CHUNK_SIZE, CHUNK_BYTE (child, chunk),
+                CHUNK_SIZE);
+      check_file (name, buf, sizeof buf);
+    }
+}
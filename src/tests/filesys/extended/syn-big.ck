@@ -0,0 +1,27 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(syn-big) begin
+(syn-big) create "big0"
+(syn-big) create "big1"
+(syn-big) create "big2"
+(syn-big) exec child 1 of 3: "child-syn-big 0"
+(syn-big) exec child 2 of 3: "child-syn-big 1"
+(syn-big) exec child 3 of 3: "child-syn-big 2"
+(syn-big) wait for child 1 of 3 returned 0 (expected 0)
+(syn-big) wait for child 2 of 3 returned 1 (expected 1)
+(syn-big) wait for child 3 of 3 returned 2 (expected 2)
+(syn-big) open "big0" for verification
+(syn-big) verified contents of "big0"
+(syn-big) close "big0"
+(syn-big) open "big1" for verification
+(syn-big) verified contents of "big1"
+(syn-big) close "big1"
+(syn-big) open "big2" for verification
+(syn-big) verified contents of "big2"
+(syn-big) close "big2"
+(syn-big) end
+EOF
+pass;
@@ -0,0 +1,12 @@
+#ifndef TESTS_FILESYS_EXTENDED_SYN_BIG_H
+#define TESTS_FILESYS_EXTENDED_SYN_BIG_H
+
+#define CHILD_CNT 3
+#define CHUNK_SIZE 1000
+#define CHUNK_CNT 64
+#define FILE_SIZE (CHUNK_SIZE * CHUNK_CNT)
+
+/* Byte that child CHILD writes in chunk CHUNK of its file. */
+#define CHUNK_BYTE(CHILD, CHUNK) ('a' + ((CHILD) * 7 + (CHUNK)) % 26)
+
+#endif /* tests/filesys/extended/syn-big.h */
@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+my ($fs);
+$fs->{'child-syn-create'} = "tests/filesys/extended/child-syn-create";
+for my $child (0...3) {
+    for my $file (0...9) {
+	$fs->{"d$child"}{"f$file"}
+	  = [chr (ord ('a') + ($child * 10 + $file) % 26) x 1024];
+    }
+}
+check_archive ($fs);
+pass;
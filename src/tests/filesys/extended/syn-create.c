@@ -0,0 +1,40 @@
+/* Creates a directory for each of several subprocesses, which
+   create and write files in them at the same time.  Checks all the
+   files once the subprocesses are done. */
+
+#include <stdio.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/filesys/extended/syn-create.h"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static char buf[FILE_SIZE];
+
+void
+test_main (void) 
+{
+  pid_t children[CHILD_CNT];
+  char name[16];
+  int child, i;
+
+  for (child = 0; child < CHILD_CNT; child++)
+    {
+      snprintf (name, sizeof name, "d%d", child);
+      CHECK (mkdir (name), "mkdir \"%s\"", name);
+    }
+
+  exec_children ("child-syn-create", children, CHILD_CNT);
+  wait_children (children, CHILD_CNT);
+
+  msg ("check the files of all children");
+  quiet = true;
+  for (child = 0; child < CHILD_CNT; child++)
+    for (i = 0; i < FILE_CNT; i++)
+      {
+        snprintf (name, sizeof name, "d%d/f%d", child, i);
+        memset (buf, FILE_BYTE (child, i), sizeof buf);
+        check_file (name, buf, sizeof buf);
+      }
+  quiet = false;
+}
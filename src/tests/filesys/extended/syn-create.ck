@@ -0,0 +1,22 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(syn-create) begin
+(syn-create) mkdir "d0"
+(syn-create) mkdir "d1"
+(syn-create) mkdir "d2"
+(syn-create) mkdir "d3"
+(syn-create) exec child 1 of 4: "child-syn-create 0"
+(syn-create) exec child 2 of 4: "child-syn-create 1"
+(syn-create) exec child 3 of 4: "child-syn-create 2"
+(syn-create) exec child 4 of 4: "child-syn-create 3"
+(syn-create) wait for child 1 of 4 returned 0 (expected 0)
+(syn-create) wait for child 2 of 4 returned 1 (expected 1)
+(syn-create) wait for child 3 of 4 returned 2 (expected 2)
+(syn-create) wait for child 4 of 4 returned 3 (expected 3)
+(syn-create) check the files of all children
+(syn-create) end
+EOF
+pass;
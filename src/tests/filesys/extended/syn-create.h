@@ -0,0 +1,11 @@
+#ifndef TESTS_FILESYS_EXTENDED_SYN_CREATE_H
+#define TESTS_FILESYS_EXTENDED_SYN_CREATE_H
+
+#define CHILD_CNT 4
+#define FILE_CNT 10
+#define FILE_SIZE 1024
+
+/* Byte that file FILE of child CHILD is filled with. */
+#define FILE_BYTE(CHILD, FILE) ('a' + ((CHILD) * FILE_CNT + (FILE)) % 26)
+
+#endif /* tests/filesys/extended/syn-create.h */
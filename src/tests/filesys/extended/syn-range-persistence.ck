@@ -0,0 +1,8 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+my ($data) = join ('', map (chr (ord ('a') + $_ % 26) x 100, 0...79));
+check_archive ({"child-syn-range" => "tests/filesys/extended/child-syn-range",
+		"rangefile" => [$data]});
+pass;
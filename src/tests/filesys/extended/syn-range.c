@@ -0,0 +1,29 @@
+/* Subprocesses write interleaved chunks of one file at the same
+   time.  No chunk may be lost to a concurrent write or to the zero
+   fill of another write that extends the file. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/filesys/extended/syn-range.h"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static char buf[FILE_SIZE];
+
+void
+test_main (void) 
+{
+  pid_t children[CHILD_CNT];
+  int child, round;
+
+  CHECK (create (file_name, 0), "create \"%s\"", file_name);
+
+  exec_children ("child-syn-range", children, CHILD_CNT);
+  wait_children (children, CHILD_CNT);
+
+  for (round = 0; round < ROUND_CNT; round++)
+    for (child = 0; child < CHILD_CNT; child++)
+      memset (buf + (round * CHILD_CNT + child) * CHUNK_SIZE,
+              CHUNK_BYTE (child, round), CHUNK_SIZE);
+  check_file (file_name, buf, sizeof buf);
+}
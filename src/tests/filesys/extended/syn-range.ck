@@ -0,0 +1,21 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(syn-range) begin
+(syn-range) create "rangefile"
+(syn-range) exec child 1 of 4: "child-syn-range 0"
+(syn-range) exec child 2 of 4: "child-syn-range 1"
+(syn-range) exec child 3 of 4: "child-syn-range 2"
+(syn-range) exec child 4 of 4: "child-syn-range 3"
+(syn-range) wait for child 1 of 4 returned 0 (expected 0)
+(syn-range) wait for child 2 of 4 returned 1 (expected 1)
+(syn-range) wait for child 3 of 4 returned 2 (expected 2)
+(syn-range) wait for child 4 of 4 returned 3 (expected 3)
+(syn-range) open "rangefile" for verification
+(syn-range) verified contents of "rangefile"
+(syn-range) close "rangefile"
+(syn-range) end
+EOF
+pass;
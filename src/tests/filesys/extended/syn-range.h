@@ -0,0 +1,13 @@
+#ifndef TESTS_FILESYS_EXTENDED_SYN_RANGE_H
+#define TESTS_FILESYS_EXTENDED_SYN_RANGE_H
+
+#define CHILD_CNT 4
+#define CHUNK_SIZE 100
+#define ROUND_CNT 20
+#define FILE_SIZE (CHILD_CNT * CHUNK_SIZE * ROUND_CNT)
+static const char file_name[] = "rangefile";
+
+/* Byte that child CHILD writes in round ROUND. */
+#define CHUNK_BYTE(CHILD, ROUND) ('a' + ((ROUND) * CHILD_CNT + (CHILD)) % 26)
+
+#endif /* tests/filesys/extended/syn-range.h */
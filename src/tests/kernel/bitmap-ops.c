@@ -0,0 +1,184 @@
+/* Checks bitmap_set_multiple(), bitmap_count(), bitmap_contains(),
+   bitmap_any(), bitmap_none(), bitmap_all(), bitmap_scan() and
+   bitmap_scan_and_flip() against a bit-by-bit reference on mixed
+   bit patterns.
+
+   The bitmap does not end on an element boundary, and the ranges
+   checked start and end inside elements, cover exactly one element
+   and cross element boundaries, so the masks for partial first and
+   last elements are exercised. */
+
+#include <bitmap.h>
+#include <random.h>
+#include <stdio.h>
+#include "tests/kernel/tests.h"
+
+/* Six and a half 32-bit elements. */
+#define BIT_CNT 208
+
+/* Range lengths checked from every start. */
+static const size_t cnts[] = {0, 1, 2, 3, 7, 31, 32, 33, 63, 64, 65, 100};
+#define CNT_CNT (sizeof cnts / sizeof *cnts)
+
+static struct bitmap *b;
+static bool ref[BIT_CNT];
+
+/* Returns the number of bits in REF from START to START + CNT,
+   exclusive, that are VALUE. */
+static size_t
+ref_count (size_t start, size_t cnt, bool value)
+{
+  size_t i, n = 0;
+
+  for (i = start; i < start + cnt; i++)
+    if (ref[i] == value)
+      n++;
+  return n;
+}
+
+/* Returns the first index from START on where REF holds CNT bits
+   that are VALUE, or BITMAP_ERROR. */
+static size_t
+ref_scan (size_t start, size_t cnt, bool value)
+{
+  size_t i, run = 0;
+
+  if (cnt == 0)
+    return start;
+  for (i = start; i < BIT_CNT; i++)
+    {
+      run = ref[i] == value ? run + 1 : 0;
+      if (run == cnt)
+        return i + 1 - cnt;
+    }
+  return BITMAP_ERROR;
+}
+
+/* Sets the CNT bits starting at START to VALUE in both B and REF. */
+static void
+set_range (size_t start, size_t cnt, bool value)
+{
+  size_t i;
+
+  bitmap_set_multiple (b, start, cnt, value);
+  for (i = start; i < start + cnt; i++)
+    ref[i] = value;
+}
+
+/* Checks every query against REF, from every start with every
+   length in CNTS that fits.  NAME describes the pattern. */
+static void
+check (const char *name)
+{
+  size_t start, i;
+  int v;
+
+  for (start = 0; start <= BIT_CNT; start++)
+    {
+      if (start < BIT_CNT && bitmap_test (b, start) != ref[start])
+        fail ("%s: bit %zu is %d", name, start, !ref[start]);
+      for (i = 0; i < CNT_CNT; i++)
+        {
+          size_t cnt = cnts[i];
+          if (start + cnt > BIT_CNT)
+            continue;
+          for (v = 0; v < 2; v++)
+            {
+              size_t got = bitmap_count (b, start, cnt, v);
+              size_t want = ref_count (start, cnt, v);
+              if (got != want)
+                fail ("%s: bitmap_count (%zu, %zu, %d) = %zu, not %zu",
+                      name, start, cnt, v, got, want);
+              if (bitmap_contains (b, start, cnt, v) != (want > 0))
+                fail ("%s: bitmap_contains (%zu, %zu, %d) wrong",
+                      name, start, cnt, v);
+              got = bitmap_scan (b, start, cnt, v);
+              want = ref_scan (start, cnt, v);
+              if (got != want)
+                fail ("%s: bitmap_scan (%zu, %zu, %d) = %zu, not %zu",
+                      name, start, cnt, v, got, want);
+            }
+          if (bitmap_any (b, start, cnt) != (ref_count (start, cnt, true) > 0)
+              || bitmap_none (b, start, cnt) != (ref_count (start, cnt, true) == 0)
+              || bitmap_all (b, start, cnt) != (ref_count (start, cnt, true) == cnt))
+            fail ("%s: bitmap_any/none/all (%zu, %zu) wrong",
+                  name, start, cnt);
+        }
+    }
+}
+
+void
+test_bitmap_ops (void)
+{
+  size_t i, round;
+
+  b = bitmap_create (BIT_CNT);
+  if (b == NULL)
+    fail ("bitmap_create() failed");
+  random_init (0);
+
+  set_range (0, BIT_CNT, false);
+  check ("all clear");
+  set_range (0, BIT_CNT, true);
+  check ("all set");
+
+  /* Alternating bits, no run longer than one */
+  for (i = 0; i < BIT_CNT; i++)
+    set_range (i, 1, i % 2);
+  check ("alternating");
+
+  /* One full element between clear ones */
+  set_range (0, BIT_CNT, false);
+  set_range (64, 32, true);
+  check ("full element");
+
+  /* Runs ending and starting at element boundaries */
+  set_range (0, BIT_CNT, false);
+  set_range (30, 4, true);
+  set_range (62, 36, true);
+  set_range (128, 32, true);
+  set_range (BIT_CNT - 1, 1, true);
+  check ("boundary runs");
+
+  /* The inverse, free runs in a full bitmap */
+  set_range (0, BIT_CNT, true);
+  set_range (30, 4, false);
+  set_range (62, 36, false);
+  set_range (128, 32, false);
+  set_range (BIT_CNT - 1, 1, false);
+  check ("boundary holes");
+
+  /* Random bits, then random unaligned ranges set and cleared */
+  for (round = 0; round < 8; round++)
+    {
+      for (i = 0; i < BIT_CNT; i++)
+        {
+          bool value = random_ulong () % 4 == 0;
+          bitmap_set (b, i, value);
+          ref[i] = value;
+        }
+      for (i = 0; i < 16; i++)
+        {
+          size_t start = random_ulong () % BIT_CNT;
+          size_t cnt = random_ulong () % (BIT_CNT - start + 1);
+          set_range (start, cnt, random_ulong () % 2);
+        }
+      check ("random");
+    }
+
+  /* bitmap_scan_and_flip() takes the first fitting run */
+  for (i = 0; i < CNT_CNT; i++)
+    {
+      size_t cnt = cnts[i], want = ref_scan (0, cnt, false);
+      size_t got = bitmap_scan_and_flip (b, 0, cnt, false);
+      if (got != want)
+        fail ("bitmap_scan_and_flip (0, %zu, 0) = %zu, not %zu",
+              cnt, got, want);
+      if (got != BITMAP_ERROR)
+        set_range (got, cnt, true);
+      check ("after bitmap_scan_and_flip");
+    }
+
+  bitmap_destroy (b);
+  pass ();
+}
@@ -0,0 +1,47 @@
+/* Measures the throughput of bitmap_scan() and bitmap_count() on
+   the free map of a completely used 8 MB disk, one bit per 512 byte
+   sector.  Every scan for a free sector has to look at the whole
+   bitmap before it fails.
+   Automatic checks only catch wrong results, the numbers are for
+   comparison by hand. */
+
+#include <bitmap.h>
+#include <stdio.h>
+#include "tests/kernel/tests.h"
+#include "devices/timer.h"
+
+/* Sectors of an 8 MB disk. */
+#define BIT_CNT (8 * 1024 * 1024 / 512)
+
+void
+test_bitmap_scan_bench (void) 
+{
+  struct bitmap *b = bitmap_create (BIT_CNT);
+  unsigned scans = 0, counts = 0;
+  int64_t start;
+
+  if (b == NULL)
+    fail ("bitmap_create() failed");
+  bitmap_set_all (b, true);
+
+  start = timer_ticks ();
+  while (timer_elapsed (start) < TIMER_FREQ)
+    {
+      if (bitmap_scan (b, 0, 1, false) != BITMAP_ERROR)
+        fail ("bitmap_scan() found a free bit in a full bitmap");
+      scans++;
+    }
+  msg ("bitmap_scan: %u scans of %d bits per second", scans, BIT_CNT);
+
+  start = timer_ticks ();
+  while (timer_elapsed (start) < TIMER_FREQ)
+    {
+      if (bitmap_count (b, 0, BIT_CNT, true) != BIT_CNT)
+        fail ("bitmap_count() miscounted a full bitmap");
+      counts++;
+    }
+  msg ("bitmap_count: %u counts of %d bits per second", counts, BIT_CNT);
+
+  bitmap_destroy (b);
+  pass ();
+}
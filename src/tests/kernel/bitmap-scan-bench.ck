@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+our ($test);
+my (@output) = read_text_file ("$test.output");
+common_checks ("run", @output);
+@output = get_core_output ("run", @output);
+fail "missing throughput\n" if grep (/ per second$/, @output) != 2;
+@output = grep (!/ per second$/, @output);
+fail "unexpected output:\n" . join ('', map ("  $_\n", @output))
+  if join ("\n", @output) ne join ("\n", "(bitmap-scan-bench) begin",
+				   "(bitmap-scan-bench) PASS",
+				   "(bitmap-scan-bench) end");
+pass;
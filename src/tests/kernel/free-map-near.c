@@ -0,0 +1,57 @@
+/* Checks where free_map_allocate_near() places runs around a goal:
+   at the goal if the run fits there, otherwise in the nearest free
+   extent behind the goal that holds it.  Works in a 64 sector area
+   of the freshly formatted disk that it frees first, and checks
+   that releasing the runs again restores the free space
+   statistics, so the extent index merged them back. */
+
+#include <stdio.h>
+#include "tests/kernel/tests.h"
+#include "filesys/free-map.h"
+
+/* Allocates CNT sectors near GOAL and fails unless they start at
+   WANT. */
+static void
+expect_near (block_sector_t goal, size_t cnt, block_sector_t want)
+{
+  block_sector_t sector;
+
+  if (!free_map_allocate_near (goal, cnt, &sector))
+    fail ("free_map_allocate_near (%"PRDSNu", %zu) failed", goal, cnt);
+  if (sector != want)
+    fail ("free_map_allocate_near (%"PRDSNu", %zu) = %"PRDSNu", "
+          "not %"PRDSNu, goal, cnt, sector, want);
+}
+
+void
+test_free_map_near (void)
+{
+  struct free_map_stats before, after;
+  block_sector_t base;
+
+  free_map_stats (&before);
+  if (!free_map_allocate (64, &base))
+    fail ("free_map_allocate (64) failed");
+  free_map_release (base, 64);
+
+  /* Free at the goal */
+  expect_near (base + 10, 4, base + 10);
+
+  /* The goal is taken, the extent right behind it */
+  expect_near (base + 10, 2, base + 14);
+
+  /* The goal is free but its extent is too short */
+  expect_near (base + 5, 8, base + 16);
+
+  free_map_release (base + 14, 2);
+  free_map_release (base + 10, 4);
+  free_map_release (base + 16, 8);
+  free_map_stats (&after);
+  if (after.free_cnt != before.free_cnt
+      || after.extent_cnt != before.extent_cnt
+      || after.largest_extent != before.largest_extent)
+    fail ("free space changed: %zu sectors in %zu extents, "
+          "not %zu in %zu", after.free_cnt, after.extent_cnt,
+          before.free_cnt, before.extent_cnt);
+  pass ();
+}
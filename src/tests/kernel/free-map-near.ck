@@ -0,0 +1,10 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(free-map-near) begin
+(free-map-near) PASS
+(free-map-near) end
+EOF
+pass;
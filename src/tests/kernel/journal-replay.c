@@ -0,0 +1,66 @@
+/* Logs a new version of a sector with journal_write(), leaves the
+   old version in place as a crash between the commit and the
+   in-place write would, and checks that journal_recover() writes
+   the new version.  Then does the same with a torn commit, whose
+   logged sector does not match the checksum, which must not be
+   replayed. */
+
+#include <string.h>
+#include "tests/kernel/tests.h"
+#include "devices/block.h"
+#include "filesys/filesys.h"
+#include "filesys/free-map.h"
+#include "filesys/journal.h"
+
+static char old_data[BLOCK_SECTOR_SIZE];
+static char new_data[BLOCK_SECTOR_SIZE];
+static char buf[BLOCK_SECTOR_SIZE];
+
+/* Fails unless SECTOR holds EXPECTED on disk.  WHAT describes the
+   case. */
+static void
+check_sector (block_sector_t sector, const char *expected, const char *what)
+{
+  block_read (fs_device, sector, buf);
+  if (memcmp (buf, expected, sizeof buf))
+    fail ("%s: sector %"PRDSNu" holds the wrong version", what, sector);
+}
+
+void
+test_journal_replay (void)
+{
+  block_sector_t sector;
+  void *data = new_data;
+  size_t cnt;
+
+  if (!free_map_allocate (1, &sector))
+    fail ("free_map_allocate (1) failed");
+  memset (old_data, 'o', sizeof old_data);
+  memset (new_data, 'n', sizeof new_data);
+
+  /* Keeps the cache from committing meanwhile */
+  journal_begin ();
+
+  block_write (fs_device, sector, old_data);
+  journal_write (&sector, &data, 1);
+  cnt = journal_recover ();
+  if (cnt != 1)
+    fail ("journal_recover() replayed %zu sectors, not 1", cnt);
+  check_sector (sector, new_data, "intact commit");
+  cnt = journal_recover ();
+  if (cnt != 0)
+    fail ("journal_recover() replayed %zu sectors of an empty journal", cnt);
+
+  /* Torn: the logged sector is not the one the checksum covers */
+  block_write (fs_device, sector, old_data);
+  journal_write (&sector, &data, 1);
+  block_write (fs_device, JOURNAL_SECTOR + 1, old_data);
+  cnt = journal_recover ();
+  if (cnt != 0)
+    fail ("journal_recover() replayed %zu sectors of a torn commit", cnt);
+  check_sector (sector, old_data, "torn commit");
+
+  journal_end ();
+  free_map_release (sector, 1);
+  pass ();
+}
@@ -0,0 +1,10 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(journal-replay) begin
+(journal-replay) PASS
+(journal-replay) end
+EOF
+pass;
@@ -0,0 +1,21 @@
+#ifndef TESTS_KERNEL_TESTS_H
+#define TESTS_KERNEL_TESTS_H
+
+/* Tests that run inside the file system kernel, selected with the
+   -ktest option.  Unlike tests/threads they have the whole kernel
+   available. */
+
+void run_test (const char *);
+
+typedef void test_func (void);
+
+extern test_func test_bitmap_ops;
+extern test_func test_bitmap_scan_bench;
+extern test_func test_free_map_near;
+extern test_func test_journal_replay;
+
+void msg (const char *, ...);
+void fail (const char *, ...);
+void pass (void);
+
+#endif /* tests/kernel/tests.h */
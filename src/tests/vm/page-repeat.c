@@ -0,0 +1,22 @@
+/* Runs child-linear processes one after another, so that every
+   child gets the frames and swap slots the one before it freed. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define CHILD_CNT 6
+
+void
+test_main (void)
+{
+  pid_t child;
+  int i;
+
+  for (i = 0; i < CHILD_CNT; i++)
+    {
+      CHECK ((child = exec ("child-linear")) != -1,
+             "exec \"child-linear\"");
+      CHECK (wait (child) == 0x42, "wait for child %d", i);
+    }
+}
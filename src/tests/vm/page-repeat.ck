@@ -0,0 +1,21 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(page-repeat) begin
+(page-repeat) exec "child-linear"
+(page-repeat) wait for child 0
+(page-repeat) exec "child-linear"
+(page-repeat) wait for child 1
+(page-repeat) exec "child-linear"
+(page-repeat) wait for child 2
+(page-repeat) exec "child-linear"
+(page-repeat) wait for child 3
+(page-repeat) exec "child-linear"
+(page-repeat) wait for child 4
+(page-repeat) exec "child-linear"
+(page-repeat) wait for child 5
+(page-repeat) end
+EOF
+pass;
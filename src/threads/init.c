@@ -31,6 +31,9 @@
 #else
 #include "tests/threads/tests.h"
 #endif
+#ifdef KERNEL_TESTS
+#include "tests/kernel/tests.h"
+#endif
 #ifdef FILESYS
 #include "devices/block.h"
 #include "devices/ide.h"
@@ -58,6 +61,11 @@ static const char *swap_bdev_name;
 /* -ul: Maximum number of pages to put into palloc's user pool. */
 static size_t user_page_limit = SIZE_MAX;
 
+#ifdef KERNEL_TESTS
+/* -ktest: Run kernel tests instead of user programs? */
+static bool kernel_tests;
+#endif
+
 static void bss_init (void);
 static void paging_init (void);
 
@@ -255,6 +263,12 @@ parse_options (char **argv)
         filesys_bdev_name = value;
       else if (!strcmp (name, "-scratch"))
         scratch_bdev_name = value;
+      else if (!strcmp (name, "-o"))
+        {
+          if (value == NULL || strcmp (value, "compress"))
+            PANIC ("unknown file system option `%s'", value);
+          filesys_compress = true;
+        }
 #ifdef VM
       else if (!strcmp (name, "-swap"))
         swap_bdev_name = value;
@@ -267,6 +281,10 @@ parse_options (char **argv)
 #ifdef USERPROG
       else if (!strcmp (name, "-ul"))
         user_page_limit = atoi (value);
+#endif
+#ifdef KERNEL_TESTS
+      else if (!strcmp (name, "-ktest"))
+        kernel_tests = true;
 #endif
       else
         PANIC ("unknown option `%s' (use -h for help)", name);
@@ -293,7 +311,12 @@ run_task (char **argv)
   
   printf ("Executing '%s':\n", task);
 #ifdef USERPROG
-  process_wait (process_execute (task));
+#ifdef KERNEL_TESTS
+  if (kernel_tests)
+    run_test (task);
+  else
+#endif
+    process_wait (process_execute (task));
 #else
   run_test (task);
 #endif
@@ -381,6 +404,7 @@ usage (void)
           "  -f                 Format file system device during startup.\n"
           "  -filesys=BDEV      Use BDEV for file system instead of default.\n"
           "  -scratch=BDEV      Use BDEV for scratch instead of default.\n"
+          "  -o=compress        Compress the data of files created.\n"
 #ifdef VM
           "  -swap=BDEV         Use BDEV for swap instead of default.\n"
 #endif
@@ -389,6 +413,9 @@ usage (void)
           "  -mlfqs             Use multi-level feedback queue scheduler.\n"
 #ifdef USERPROG
           "  -ul=COUNT          Limit user memory to COUNT pages.\n"
+#endif
+#ifdef KERNEL_TESTS
+          "  -ktest             Run kernel tests instead of programs.\n"
 #endif
           );
   shutdown_power_off ();
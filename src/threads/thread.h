@@ -7,6 +7,7 @@
 #include <stdint.h>
 #include "userprog/process.h"
 #include "filesys/directory.h"
+#include "filesys/free-map.h"
 
 /* States in a thread's life cycle. */
 enum thread_status
@@ -110,6 +111,13 @@ struct thread
     // use for filesys
     struct file *current_work_dir;
 
+    // sectors reserved for file system metadata
+    // returned on exit
+    struct free_map_reservation fs_reserve;
+
+    // nesting depth of journal_begin() calls
+    int journal_depth;
+
     /* Owned by thread.c. */
     unsigned magic;                     /* Detects stack overflow. */
   };
@@ -710,6 +710,10 @@ process_exit (void)
   struct thread *cur = thread_current ();
   uint32_t *pd;
 
+  /* Give back the sectors reserved for new metadata, every exiting
+     thread passes here, kernel threads and killed processes too. */
+  free_map_return (&cur->fs_reserve);
+
   /* Destroy the current process's page directory and switch back
      to the kernel-only page directory. */
   pd = cur->pagedir;
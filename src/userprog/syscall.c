@@ -6,6 +6,7 @@
 #include "filesys/filesys.h"
 #include "filesys/file.h"
 #include "filesys/directory.h"
+#include "filesys/free-map.h"
 #include "filesys/inode.h"
 #include "devices/shutdown.h"
 #include "devices/input.h"
@@ -279,6 +280,97 @@ syscall_readdir(int fd, char *file_name) {
   return dir_readdir(f, file_name);
 }
 
+/* Fills ENTRIES with up to CNT entries of the directory open as FD.
+   Returns the number filled in, 0 at the end of the directory, or -1
+   if FD is not an open directory. */
+static int
+syscall_getdents(int fd, struct dirent *entries, unsigned cnt) {
+  struct dir_record records[8];
+  unsigned n = 0;
+  struct file *f = get_fdlist(thread_current()->pid, fd);
+  if (!f) // file does not exist
+    return -1;
+  if (!file_isdir(f))
+    return -1;
+
+  while (n < cnt) {
+    size_t want = cnt - n < 8 ? cnt - n : 8;
+    size_t got = dir_readdir_batch(f, records, want);
+    size_t i;
+    for (i = 0; i < got; i++, n++) {
+      entries[n].inumber = records[i].sector;
+      entries[n].is_dir = records[i].is_dir;
+      strlcpy(entries[n].name, records[i].name, sizeof entries[n].name);
+    }
+    if (got < want)
+      break;
+  }
+  return n;
+}
+
+static bool
+syscall_fallocate(int fd, unsigned offset, unsigned length) {
+  struct file *f = get_fdlist(thread_current()->pid, fd);
+  if (!f) // file does not exist
+    return false;
+  if (file_isdir(f))
+    return false;
+  if (offset > INT32_MAX || length > INT32_MAX)
+    return false;
+  return file_allocate(f, offset, length);
+}
+
+static int
+syscall_seek_data(int fd, unsigned position, int whence) {
+  struct file *f = get_fdlist(thread_current()->pid, fd);
+  if (!f) // file does not exist
+    return -1;
+  if (file_isdir(f))
+    return -1;
+  if (position > INT32_MAX)
+    return -1;
+  if (whence != SEEK_DATA && whence != SEEK_HOLE)
+    return -1;
+  return file_seek_data(f, position, whence == SEEK_HOLE);
+}
+
+static bool
+syscall_clone(const char *path, const char *new_path) {
+  return filesys_clone(path, new_path);
+}
+
+static bool
+syscall_defrag(int fd, struct defrag_stats *stats) {
+  struct free_map_stats free_stats;
+  size_t before, after;
+  struct file *f = get_fdlist(thread_current()->pid, fd);
+  if (!f) // file does not exist
+    return false;
+  if (file_isdir(f))
+    return false;
+
+  free_map_stats(&free_stats);
+  stats->free_extents_before = free_stats.extent_cnt;
+  before = after = 0;
+  stats->sectors = inode_defrag(file_get_inode(f), &before, &after);
+  stats->extents_before = before;
+  stats->extents_after = after;
+  free_map_stats(&free_stats);
+  stats->free_extents_after = free_stats.extent_cnt;
+  return true;
+}
+
+static bool
+syscall_directio(int fd, bool enable) {
+  struct file *f = get_fdlist(thread_current()->pid, fd);
+  if (!f) // file does not exist
+    return false;
+  if (file_isdir(f))
+    return false;
+  file_set_direct(f, enable);
+  return true;
+}
+
 
 /*
  * Validates that every byte of a user provided char* is
@@ -363,8 +455,10 @@ syscall_handler (struct intr_frame *f)
 {
   void *buffer_user;
   char *file_name, *file_name_uaddr, *exec_name, *exec_name_uaddr ;
-  unsigned size, position, s_l;
-  int status, pid, fd, mapid;
+  char *new_name, *new_name_uaddr;
+  unsigned size, position, s_l, s_l_new, length;
+  int status, pid, fd, mapid, whence;
+  bool enable;
   void *vaddr;
 
   void *esp =f->esp;
@@ -530,6 +624,74 @@ syscall_handler (struct intr_frame *f)
                    f->eax = syscall_inumber(fd);
                    unpin_page(f->esp+4);
                    break;
+    case SYS_FALLOCATE:
+                   log_debug("SYS_FALLOCATE\n");
+                   fd = *((int*) uaddr_to_kaddr(f->esp+4, esp));
+                   position = *((unsigned*) uaddr_to_kaddr(f->esp+8, esp));
+                   length = *((unsigned*) uaddr_to_kaddr(f->esp+12, esp));
+                   f->eax = syscall_fallocate(fd, position, length);
+                   unpin_page(f->esp+4);
+                   unpin_page(f->esp+8);
+                   unpin_page(f->esp+12);
+                   break;
+    case SYS_SEEK_DATA:
+                   log_debug("SYS_SEEK_DATA\n");
+                   fd = *((int*) uaddr_to_kaddr(f->esp+4, esp));
+                   position = *((unsigned*) uaddr_to_kaddr(f->esp+8, esp));
+                   whence = *((int*) uaddr_to_kaddr(f->esp+12, esp));
+                   f->eax = syscall_seek_data(fd, position, whence);
+                   unpin_page(f->esp+4);
+                   unpin_page(f->esp+8);
+                   unpin_page(f->esp+12);
+                   break;
+    case SYS_CLONE:
+                   log_debug("SYS_CLONE\n");
+                   file_name_uaddr = *((char**) uaddr_to_kaddr(f->esp+4, esp)); /* char pointer in usermode */
+                   s_l = validate_user_string(file_name_uaddr, esp);
+                   file_name = (char*) uaddr_to_kaddr(file_name_uaddr, esp); /* char pointer in kernel mode */
+                   new_name_uaddr = *((char**) uaddr_to_kaddr(f->esp+8, esp)); /* char pointer in usermode */
+                   s_l_new = validate_user_string(new_name_uaddr, esp);
+                   new_name = (char*) uaddr_to_kaddr(new_name_uaddr, esp); /* char pointer in kernel mode */
+                   f->eax = syscall_clone(file_name, new_name);
+                   unpin_page(f->esp+4);
+                   unpin_page(f->esp+8);
+                   unpin_buffer(file_name_uaddr, s_l);
+                   unpin_buffer(new_name_uaddr, s_l_new);
+                   break;
+    case SYS_GETDENTS:
+                   log_debug("SYS_GETDENTS\n");
+                   fd = *((int*) uaddr_to_kaddr(f->esp+4, esp));
+                   buffer_user = *((void**)uaddr_to_kaddr(f->esp+8, esp)); /* struct dirent* in user mode */
+                   length = *((unsigned *)uaddr_to_kaddr(f->esp+12, esp));
+                   if (length > (unsigned) PHYS_BASE / sizeof (struct dirent))
+                     length = (unsigned) PHYS_BASE / sizeof (struct dirent);
+                   size = length * sizeof (struct dirent);
+                   validate_user_buffer_write(buffer_user, size, esp, true); /* validates user input */
+                   f->eax = syscall_getdents(fd, buffer_user, length);
+                   unpin_page(f->esp+4);
+                   unpin_page(f->esp+8);
+                   unpin_page(f->esp+12);
+                   unpin_buffer(buffer_user, size);
+                   break;
+    case SYS_DEFRAG:
+                   log_debug("SYS_DEFRAG\n");
+                   fd = *((int*) uaddr_to_kaddr(f->esp+4, esp));
+                   buffer_user = *((void**)uaddr_to_kaddr(f->esp+8, esp)); /* struct defrag_stats* in user mode */
+                   size = sizeof (struct defrag_stats);
+                   validate_user_buffer_write(buffer_user, size, esp, true); /* validates user input */
+                   f->eax = syscall_defrag(fd, buffer_user);
+                   unpin_page(f->esp+4);
+                   unpin_page(f->esp+8);
+                   unpin_buffer(buffer_user, size);
+                   break;
+    case SYS_DIRECTIO:
+                   log_debug("SYS_DIRECTIO\n");
+                   fd = *((int*) uaddr_to_kaddr(f->esp+4, esp));
+                   enable = *((int*) uaddr_to_kaddr(f->esp+8, esp)) != 0;
+                   f->eax = syscall_directio(fd, enable);
+                   unpin_page(f->esp+4);
+                   unpin_page(f->esp+8);
+                   break;
 
     default:
                    syscall_exit(-1);
@@ -23,9 +23,9 @@ struct frametable {
     // Points to the next frametable entry for inspection
     // must always be >= 0 and < size
     uint32_t evict_ptr;
-    // Points to the start location of the next free frame
-    // must always be >= 0 and < size
-    uint32_t search_ptr;
+    // Index of the first free frametable entry, free entries are
+    // chained through their `tid` field, `size` ends the list
+    uint32_t free_head;
     // Array of framtable entries
     // contains `size` many entries
     struct frametable_entry* frametable;
@@ -49,7 +49,6 @@ frame_init(uint32_t size,
     frametable.size = size;
     frametable.used = 0;
     frametable.evict_ptr = 0;
-    frametable.search_ptr = 0;
     frametable.base_addr = frame_base_addr;
     lock_init(&vm_lock);
 
@@ -68,6 +67,14 @@ frame_init(uint32_t size,
                                 true // never evict pages
         );
     }
+
+    // chain all remaining entries, lowest frame first
+    frametable.free_head = frametable.size;
+    for (i = size; i > frametable.own_used; i--) {
+        frametable.frametable[i - 1].pte = NULL;
+        frametable.frametable[i - 1].tid = frametable.free_head;
+        frametable.free_head = i - 1;
+    }
 }
 
 /*
@@ -119,9 +126,12 @@ frame_remove(void *frame_address) {
         PANIC("Remove of pinned frame!");
     }
     ASSERT(frametable.frametable[pgnum].pin == false);
+    ASSERT(frametable.frametable[pgnum].pte != NULL);
 
     // TODO reset everything
     frametable.frametable[pgnum].pte = NULL;
+    frametable.frametable[pgnum].tid = frametable.free_head;
+    frametable.free_head = pgnum;
     frametable.used--;
     lock_release_re(&vm_lock);
 }
@@ -144,22 +154,18 @@ void*
 frame_get_free() {
     lock_acquire_re(&vm_lock);
     log_debug("+++ frame_get_free (used: %d, own used: %d) +++\n", frametable.used, frametable.own_used);
-    // TODO
-    if (frametable.used < frametable.size) {
-        // some free frames left
-        while(1) {
-            if (frametable.frametable[frametable.search_ptr].pte == NULL) {
-                // FIXME reserve entry by changing pointer
-                frametable.frametable[frametable.search_ptr].pte = (void*) 0xFFFFFFFF;
-                frametable.used++;
-                void* tmp = pagenum_to_page(frametable.search_ptr);
-                log_debug("### Free page at 0x%08x ###\n", (uint32_t) tmp);
-                lock_release_re(&vm_lock);
-                return tmp;
-            }
-            // jump to next position
-            frametable.search_ptr = (frametable.search_ptr + 1) % frametable.size;
-        }
+    if (frametable.free_head < frametable.size) {
+        // some free frames left, pop the head of the free list
+        uint32_t pgnum = frametable.free_head;
+        ASSERT(frametable.frametable[pgnum].pte == NULL);
+        frametable.free_head = frametable.frametable[pgnum].tid;
+        // FIXME reserve entry by changing pointer
+        frametable.frametable[pgnum].pte = (void*) 0xFFFFFFFF;
+        frametable.used++;
+        void* tmp = pagenum_to_page(pgnum);
+        log_debug("### Free page at 0x%08x ###\n", (uint32_t) tmp);
+        lock_release_re(&vm_lock);
+        return tmp;
     } else {
         // no free frames left
         // evict frame
@@ -171,6 +177,15 @@ frame_get_free() {
     return NULL;
 }
 
+/*
+ * Returns the number of free frames, i.e. how many calls to
+ * `frame_get_free` succeed without evicting a frame.
+ */
+uint32_t
+frame_free_cnt(void) {
+    return frametable.size - frametable.used;
+}
+
 void
 frame_set_pin(void *page, bool pin) {
     lock_acquire_re(&vm_lock);
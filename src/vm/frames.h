@@ -6,7 +6,8 @@
 
 /*
  * A FTE is free if the `pte` field is NULL.
- * The meaning of other fields is undefined in this case.
+ * The `tid` field then links to the next free entry (see frames.c),
+ * the meaning of other fields is undefined in this case.
  *
  * If `pte` is a valid pointer, `pid` must correspond to a
  * valid, currently used process id and `virt_address` to a
@@ -37,6 +38,7 @@ void frame_remove(void *frame_address);
 void frame_remove_mult(void *frame_address,
                        size_t cnt);
 void* frame_get_free(void);
+uint32_t frame_free_cnt(void);
 void frame_set_pin(void *page, bool pin);
 void* frame_evict(void);
 